@@ -0,0 +1,244 @@
+/*
+  @copyright Steve Keen 2019
+  @author Russell Standish
+  This file is part of Minsky.
+
+  Minsky is free software: you can redistribute it and/or modify it
+  under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Minsky is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Minsky.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+  Headless driver for running Minsky models without the Tk GUI. Loads
+  a model, applies parameter overrides, integrates to a given time,
+  and writes selected variables to a file. No TCL interpreter is run,
+  and icons, plots and the canvas are not updated during the run.
+*/
+
+#include "minsky.h"
+#include "sensitivity.h"
+#include <ecolab_epilogue.h>
+
+#include <boost/program_options.hpp>
+#include <fstream>
+#include <iostream>
+
+using namespace std;
+using namespace minsky;
+namespace po=boost::program_options;
+
+namespace ecolab
+{
+  Tk_Window mainWin=0;
+}
+
+namespace minsky
+{
+  namespace
+  {
+    Minsky* l_minsky=NULL;
+  }
+
+  Minsky& minsky()
+  {
+    static Minsky s_minsky;
+    if (l_minsky)
+      return *l_minsky;
+    else
+      return s_minsky;
+  }
+
+  LocalMinsky::LocalMinsky(Minsky& minsky) {l_minsky=&minsky;}
+  LocalMinsky::~LocalMinsky() {l_minsky=NULL;}
+
+  // no GUI events to process
+  void doOneEvent(bool) {}
+}
+
+namespace
+{
+  /// return the valueId corresponding to variable \a name, which may
+  /// be a fully qualified valueId, or the name of a global variable
+  string lookupVariable(const string& name)
+  {
+    auto& values=minsky::minsky().variableValues;
+    if (values.count(name))
+      return name;
+    string id=VariableValue::valueId(name.find(':')==string::npos? ":"+name: name);
+    if (values.count(id))
+      return id;
+    throw error("variable %s not found in model",name.c_str());
+  }
+
+  void setParameter(const string& name, const string& value)
+  {
+    auto& values=minsky::minsky().variableValues;
+    auto& v=values[lookupVariable(name)];
+    if (v.isFlowVar() && minsky::cminsky().definingVar(v.valueId()))
+      throw error("%s is defined by an expression, so cannot be overridden",name.c_str());
+    v.init=value;
+  }
+
+  /// parse an override of the form name=value
+  void setParameter(const string& assignment)
+  {
+    auto eq=assignment.find('=');
+    if (eq==string::npos)
+      throw error("invalid parameter override %s, should be name=value",assignment.c_str());
+    setParameter(assignment.substr(0,eq), assignment.substr(eq+1));
+  }
+
+  /// read overrides from a file, one name=value or name value pair
+  /// per line. Blank lines, and lines starting with # are ignored
+  void readParameterFile(const string& filename)
+  {
+    ifstream f(filename);
+    if (!f)
+      throw runtime_error("failed to open "+filename);
+    string line;
+    while (getline(f,line))
+      {
+        auto start=line.find_first_not_of(" \t\r");
+        if (start==string::npos || line[start]=='#') continue;
+        line=line.substr(start, line.find_last_not_of(" \t\r")+1-start);
+        if (line.find('=')==string::npos)
+          {
+            auto sep=line.find_first_of(" \t");
+            if (sep==string::npos)
+              throw error("invalid line in %s: %s",filename.c_str(),line.c_str());
+            line[sep]='=';
+          }
+        setParameter(line);
+      }
+  }
+}
+
+int main(int argc, char* argv[])
+{
+  double tEnd, interval;
+  bool steadyState;
+  string modelFile, outputFile, paramFile;
+  vector<string> overrides, outputVars, sensitivityParams;
+
+  po::options_description options("Usage: minskyBatch [options] model.mky\nOptions");
+  options.add_options()
+    ("help,h", "print this help message")
+    ("until,t", po::value<double>(&tEnd)->required(), "simulation time to integrate to")
+    ("interval,i", po::value<double>(&interval)->default_value(0),
+     "time between output records. If 0, only the initial and final states are written")
+    ("set,s", po::value<vector<string>>(&overrides), "override a parameter or initial condition: name=value")
+    ("param-file,p", po::value<string>(&paramFile), "file of parameter overrides, one name=value per line")
+    ("var,v", po::value<vector<string>>(&outputVars),
+     "variable to output. If none specified, all variables are output")
+    ("output,o", po::value<string>(&outputFile)->default_value("minsky.dat"), "output file")
+    ("sensitivity,S", po::value<vector<string>>(&sensitivityParams),
+     "parameter, or stock variable for its initial value, to compute gradients of the output "
+     "variables with respect to. The gradients at the end of the run are written to standard output")
+    ("steady-state", po::bool_switch(&steadyState),
+     "start the run from a steady state of the model, found from its initial conditions")
+    ("model", po::value<string>(&modelFile)->required(), "model file");
+  po::positional_options_description positional;
+  positional.add("model",1);
+
+  try
+    {
+      po::variables_map vm;
+      po::store(po::command_line_parser(argc,argv).options(options).
+                positional(positional).run(), vm);
+      if (vm.count("help"))
+        {
+          cout << options << endl;
+          return 0;
+        }
+      po::notify(vm);
+
+      auto& m=minsky::minsky();
+      m.load(modelFile);
+      // file overrides are applied first, so that command line
+      // overrides take precedence
+      if (!paramFile.empty())
+        readParameterFile(paramFile);
+      for (auto& i: overrides)
+        setParameter(i);
+      m.reset();
+      if (steadyState)
+        m.findSteadyState();
+
+      if (outputVars.empty())
+        for (auto& v: m.variableValues)
+          {
+            if (!v.second.temp())
+              m.logVarList.insert(v.first);
+          }
+      else
+        for (auto& v: outputVars)
+          m.logVarList.insert(lookupVariable(v));
+      m.openLogFile(outputFile);
+      m.logVariables();
+
+      // sensitivity equations are integrated alongside the model if requested
+      unique_ptr<SensitivityAnalysis> sensitivity;
+      if (!sensitivityParams.empty())
+        {
+          vector<string> params;
+          for (auto& p: sensitivityParams)
+            params.push_back(lookupVariable(p));
+          sensitivity.reset(new SensitivityAnalysis
+                            (m, params, vector<string>(m.logVarList.begin(), m.logVarList.end())));
+        }
+      auto runUntil=[&](double t) {
+        if (sensitivity)
+          sensitivity->runUntil(t);
+        else
+          m.runUntil(t);
+      };
+
+      if (interval>0)
+        while (m.t<tEnd)
+          {
+            runUntil(min(m.t+interval, tEnd));
+            m.logVariables();
+          }
+      else
+        {
+          runUntil(tEnd);
+          m.logVariables();
+        }
+      m.closeLogFile();
+
+      if (sensitivity)
+        {
+          // CSV table of d(variable)/d(parameter)
+          cout << "variable";
+          for (auto& p: sensitivityParams)
+            cout << "," << p;
+          cout << endl;
+          auto gradients=sensitivity->gradients();
+          size_t i=0;
+          for (auto& v: m.logVarList)
+            {
+              cout << v;
+              for (auto g: gradients[i++])
+                cout << "," << g;
+              cout << endl;
+            }
+        }
+    }
+  catch (const std::exception& ex)
+    {
+      cerr << ex.what() << endl;
+      if (dynamic_cast<const po::error*>(&ex))
+        cerr << options << endl;
+      return 1;
+    }
+  return 0;
+}
@@ -0,0 +1,68 @@
+/*
+  @copyright Steve Keen 2019
+  @author Russell Standish
+  This file is part of Minsky.
+
+  Minsky is free software: you can redistribute it and/or modify it
+  under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Minsky is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Minsky.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+  Converts binary simulation logs (.mlog) to text, either in the
+  space separated format written by Minsky's text logs, or as CSV.
+*/
+
+#include "simulationLog.h"
+#include <iostream>
+#include <limits>
+#include <string.h>
+
+using namespace std;
+using namespace minsky;
+
+int main(int argc, char* argv[])
+{
+  bool csv=argc>1 && strcmp(argv[1],"--csv")==0;
+  if (argc!=2+csv)
+    {
+      cerr << "Usage: "<<argv[0]<<" [--csv] log.mlog >output\n";
+      return 1;
+    }
+  try
+    {
+      vector<string> names;
+      vector<vector<double>> columns;
+      SimulationLog::readBinary(argv[1+csv], names, columns);
+
+      const char* sep=csv? ",": " ";
+      if (!csv) cout<<"#";
+      for (size_t c=0; c<names.size(); ++c)
+        cout<<(c? sep: "")<<names[c];
+      cout<<"\n";
+      if (csv)
+        cout.precision(numeric_limits<double>::max_digits10);
+      size_t rows=columns.empty()? 0: columns[0].size();
+      for (size_t r=0; r<rows; ++r)
+        {
+          for (size_t c=0; c<columns.size(); ++c)
+            cout<<(c? sep: "")<<columns[c][r];
+          cout<<"\n";
+        }
+    }
+  catch (const std::exception& ex)
+    {
+      cerr << ex.what() << endl;
+      return 1;
+    }
+  return 0;
+}
@@ -448,6 +448,8 @@ namespace minsky
               }
           }
   
+        // discard any data loaded from file before reallocating
+        v.deferredTensorInit.reset();
         v.setXVector(xVector);
         if (!cminsky().checkMemAllocation(v.numElements()*sizeof(double)))
           throw runtime_error("memory threshold exeeded");
@@ -488,6 +488,15 @@ namespace MathDAG
     zero->result=&const_cast<Minsky&>(m).variableValues.find("constant:zero")->second;
     one->result=&const_cast<Minsky&>(m).variableValues.find("constant:one")->second;
 
+    minsky.model->recursiveDo
+      (&Group::items,
+       [&](const Items&, Items::const_iterator it){
+        if (auto v=(*it)->variableCast())
+          if (v->definesValue())
+            definingVars.emplace(v->valueId(), dynamic_pointer_cast<VariableBase>(*it));
+        return false;
+      });
+
     // store stock & integral variables for later reordering
     map<string, VariableDAG*> integVarMap;
 
@@ -598,7 +607,7 @@ namespace MathDAG
 
     // now start with the variables, and work our way back to how they
     // are defined
-    for (VariableValues::value_type v: m.variableValues)
+    for (auto& v: m.variableValues)
       if (v.second.isFlowVar())
         if (auto vv=dynamic_cast<VariableDAG*>
             (makeDAG(v.first, v.second.name, v.second.type()).get()))
@@ -616,7 +625,7 @@ namespace MathDAG
 
     assert(VariableValue::isValueId(valueId));
     assert(minsky.variableValues.count(valueId));
-    VariableValue vv=minsky.variableValues[valueId];
+    auto& vv=minsky.variableValues.find(valueId)->second;
 
     if (type==VariableType::constant)
       {
@@ -634,9 +643,13 @@ namespace MathDAG
     shared_ptr<VariableDAG> r(new VariableDAG(valueId, nm, type));
     expressionCache.insert(valueId, r);
     r->init=vv.init;
-    if (auto v=minsky.definingVar(valueId))
-      if (v->type()!=VariableType::integral && v->numPorts()>1 && !v->ports[1]->wires().empty())
-        r->rhs=getNodeFromWire(*v->ports[1]->wires()[0]);
+    auto def=definingVars.find(valueId);
+    if (def!=definingVars.end())
+      {
+        auto& v=def->second;
+        if (v->type()!=VariableType::integral && v->numPorts()>1 && !v->ports[1]->wires().empty())
+          r->rhs=getNodeFromWire(*v->ports[1]->wires()[0]);
+      }
     return r;
   }
 
@@ -34,6 +34,7 @@
 #include <ostream>
 #include <vector>
 #include <map>
+#include <unordered_map>
 #include <string>
 #include "integral.h"
 
@@ -338,6 +339,10 @@ namespace MathDAG
 
     const Minsky& minsky;
 
+    /// variables defining each valueId, gathered in a single pass
+    /// over the model, rather than searching it for each variable
+    std::unordered_map<std::string, VariablePtr> definingVars;
+
     /// create a variable DAG. returns cached value if previously called
     NodePtr makeDAG(const string& valueId, const string& name, VariableType::Type type);
     NodePtr makeDAG(VariableBase& v)
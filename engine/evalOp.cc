@@ -115,6 +115,43 @@ namespace minsky
                   OperationBase::typeName(type()).c_str());
   }
 
+  bool EvalOpBase::piecewise() const
+  {
+    switch (type())
+      {
+      case lt: case le: case eq: case OperationType::min: case OperationType::max:
+      case OperationType::abs: case OperationType::floor: case frac: case data:
+        // only scalar operations are tracked
+        return in1.size()==1 && (numArgs()<2 || (in2.size()==1 && !in2[0].empty()));
+      default:
+        return false;
+      }
+  }
+
+  double EvalOpBase::branch(const double sv[], const double fv[]) const
+  {
+    double x1=flow1? fv[in1[0]]: sv[in1[0]];
+    double x2=numArgs()<2? 0: flow2? fv[in2[0][0].idx]: sv[in2[0][0].idx];
+    switch (type())
+      {
+      case lt: case le: case eq: case OperationType::min: case OperationType::max:
+      case OperationType::abs:
+        return (x1>x2)-(x1<x2);
+      case OperationType::floor: case frac:
+        return ::floor(x1);
+      case data:
+        // the data point at the upper end of the interval containing x1
+        if (auto d=dynamic_cast<DataOp*>(state.get()))
+          {
+            auto v=d->data.lower_bound(x1);
+            return v==d->data.end()? numeric_limits<double>::max(): v->first;
+          }
+        return 0;
+      default:
+        return 0;
+      }
+  }
+
   double ConstantEvalOp::evaluate(double in1, double in2) const
   {return value;}
   template <>
@@ -127,7 +164,7 @@ namespace minsky
   double EvalOp<OperationType::constant>::d2(double x1, double x2) const
   {return 0;}
 
-  double EvalOpBase::t;
+  thread_local double EvalOpBase::t;
   string EvalOpBase::timeUnit;
 
   template <>
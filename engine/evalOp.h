@@ -49,8 +49,9 @@ namespace minsky
   {
     typedef OperationType::Type Type;
 
-    // value used for the time operator
-    static double t;
+    // value used for the time operator. Specific to each thread, so
+    // the simulation thread evaluates at its own time.
+    static thread_local double t;
     static std::string timeUnit;
 
     /// indexes into the flow/stock variables vector
@@ -113,6 +114,13 @@ namespace minsky
 
     /// set additional tensor operation related parameters
     virtual void setTensorParams(const VariableValue&,const OperationBase&) {}
+
+    /// true if this operation is discontinuous, or has a
+    /// discontinuous derivative, as a function of its arguments
+    bool piecewise() const;
+    /// identifies the smooth piece of this operation that its
+    /// arguments currently lie on. Only meaningful if piecewise()
+    double branch(const double sv[], const double fv[]) const;
   };
 
   template <minsky::OperationType::Type T>
@@ -0,0 +1,245 @@
+/*
+  @copyright Steve Keen 2019
+  @author Russell Standish
+  This file is part of Minsky.
+
+  Minsky is free software: you can redistribute it and/or modify it
+  under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Minsky is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Minsky.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "sparseLU.h"
+#include <algorithm>
+#include <math.h>
+using namespace std;
+
+namespace minsky
+{
+  vector<double> SparseMatrix::operator*(const vector<double>& x) const
+  {
+    vector<double> r(n);
+    for (size_t j=0; j<n; ++j)
+      for (size_t p=colStart[j]; p<colStart[j+1]; ++p)
+        r[rowIdx[p]]+=values[p]*x[j];
+    return r;
+  }
+
+  // depth first search of the graph of L from row j, pushing
+  // finished nodes onto xi[top..n) in topological order
+  size_t SparseLU::dfs(size_t j, size_t top)
+  {
+    long head=0;
+    stack[0]=j;
+    while (head>=0)
+      {
+        j=stack[head];
+        long jnew=pinv[j];
+        if (!marked[j])
+          {
+            marked[j]=1;
+            // stack[n+head] holds the next edge of node stack[head] to visit
+            stack[L.n+head]= jnew<0? 0: L.colStart[jnew];
+          }
+        bool done=true;
+        size_t pend= jnew<0? 0: L.colStart[jnew+1];
+        for (size_t p=stack[L.n+head]; p<pend; ++p)
+          {
+            size_t i=L.rowIdx[p];
+            if (marked[i]) continue;
+            stack[L.n+head]=p;
+            stack[++head]=i;
+            done=false;
+            break;
+          }
+        if (done)
+          {
+            --head;
+            xi[--top]=j;
+          }
+      }
+    return top;
+  }
+
+  // compute the nonzero pattern of L\A(:,k), in xi[top..n)
+  size_t SparseLU::reach(const SparseMatrix& A, size_t k)
+  {
+    size_t top=A.n;
+    for (size_t p=A.colStart[k]; p<A.colStart[k+1]; ++p)
+      if (!marked[A.rowIdx[p]])
+        top=dfs(A.rowIdx[p], top);
+    for (size_t p=top; p<A.n; ++p)
+      marked[xi[p]]=0;
+    return top;
+  }
+
+  bool SparseLU::factor(const SparseMatrix& A)
+  {
+    size_t n=A.n;
+    factored=false;
+    L=SparseMatrix();
+    U=SparseMatrix();
+    L.n=U.n=n;
+    reachStart.assign(1,0);
+    reachRows.clear();
+    L.colStart.resize(n+1);
+    U.colStart.resize(n+1);
+    pinv.assign(n,-1);
+    xi.resize(n);
+    stack.resize(2*n);
+    marked.assign(n,0);
+    x.assign(n,0);
+
+    for (size_t k=0; k<n; ++k)
+      {
+        L.colStart[k]=L.values.size();
+        U.colStart[k]=U.values.size();
+
+        // sparse triangular solve x=L\A(:,k)
+        size_t top=reach(A,k);
+        reachRows.insert(reachRows.end(), xi.begin()+top, xi.begin()+n);
+        reachStart.push_back(reachRows.size());
+        for (size_t p=top; p<n; ++p)
+          x[xi[p]]=0;
+        for (size_t p=A.colStart[k]; p<A.colStart[k+1]; ++p)
+          x[A.rowIdx[p]]=A.values[p];
+        for (size_t px=top; px<n; ++px)
+          {
+            size_t j=xi[px];
+            long J=pinv[j];
+            if (J<0) continue;
+            // diagonal of L is unity, and stored first
+            for (size_t p=L.colStart[J]+1; p<L.colStart[J+1]; ++p)
+              x[L.rowIdx[p]]-=L.values[p]*x[j];
+          }
+
+        // find pivot, and store the U part of the column
+        long ipiv=-1;
+        double a=-1;
+        for (size_t p=top; p<n; ++p)
+          {
+            size_t i=xi[p];
+            if (pinv[i]<0)
+              {
+                if (fabs(x[i])>a)
+                  {
+                    a=fabs(x[i]);
+                    ipiv=i;
+                  }
+              }
+            else
+              {
+                U.rowIdx.push_back(pinv[i]);
+                U.values.push_back(x[i]);
+              }
+          }
+        if (ipiv<0 || a<=0 || !isfinite(a))
+          return false;
+        if (pinv[k]<0 && fabs(x[k])>=a*pivotTolerance)
+          ipiv=k;
+
+        // diagonal of U is stored last
+        double pivot=x[ipiv];
+        U.rowIdx.push_back(k);
+        U.values.push_back(pivot);
+        pinv[ipiv]=k;
+        L.rowIdx.push_back(ipiv);
+        L.values.push_back(1);
+        for (size_t p=top; p<n; ++p)
+          {
+            size_t i=xi[p];
+            if (pinv[i]<0)
+              {
+                L.rowIdx.push_back(i);
+                L.values.push_back(x[i]/pivot);
+              }
+            x[i]=0;
+          }
+      }
+    L.colStart[n]=L.values.size();
+    U.colStart[n]=U.values.size();
+    // renumber rows of L into pivot order
+    for (auto& i: L.rowIdx)
+      i=pinv[i];
+    prow.resize(n);
+    for (size_t i=0; i<n; ++i)
+      prow[pinv[i]]=i;
+    aColStart=A.colStart;
+    aRowIdx=A.rowIdx;
+    factored=true;
+    return true;
+  }
+
+  bool SparseLU::refactor(const SparseMatrix& A)
+  {
+    if (!factored || A.n!=L.n || A.colStart!=aColStart || A.rowIdx!=aRowIdx)
+      return false;
+    size_t n=A.n;
+    for (size_t k=0; k<n; ++k)
+      {
+        auto rBegin=reachRows.begin()+reachStart[k], rEnd=reachRows.begin()+reachStart[k+1];
+        // x=L\A(:,k), with x zero on entry
+        for (size_t p=A.colStart[k]; p<A.colStart[k+1]; ++p)
+          x[A.rowIdx[p]]=A.values[p];
+        for (auto r=rBegin; r!=rEnd; ++r)
+          {
+            size_t J=pinv[*r];
+            if (J>=k) continue;
+            for (size_t p=L.colStart[J]+1; p<L.colStart[J+1]; ++p)
+              x[prow[L.rowIdx[p]]]-=L.values[p]*x[*r];
+          }
+
+        // check the pivot is still acceptable
+        double pivot=x[prow[k]], a=0;
+        for (auto r=rBegin; r!=rEnd; ++r)
+          if (size_t(pinv[*r])>=k)
+            a=max(a, fabs(x[*r]));
+        bool ok=a>0 && isfinite(a) && fabs(pivot)>=a*pivotTolerance;
+
+        if (ok)
+          {
+            for (size_t p=U.colStart[k]; p<U.colStart[k+1]-1; ++p)
+              U.values[p]=x[prow[U.rowIdx[p]]];
+            U.values[U.colStart[k+1]-1]=pivot;
+            for (size_t p=L.colStart[k]+1; p<L.colStart[k+1]; ++p)
+              L.values[p]=x[prow[L.rowIdx[p]]]/pivot;
+          }
+        for (auto r=rBegin; r!=rEnd; ++r)
+          x[*r]=0;
+        if (!ok)
+          {
+            factored=false;
+            return false;
+          }
+      }
+    return true;
+  }
+
+  void SparseLU::solve(vector<double>& b) const
+  {
+    size_t n=L.n;
+    vector<double> y(n);
+    for (size_t i=0; i<n; ++i)
+      y[pinv[i]]=b[i];
+    // forward substitution with unit lower triangular L
+    for (size_t j=0; j<n; ++j)
+      for (size_t p=L.colStart[j]+1; p<L.colStart[j+1]; ++p)
+        y[L.rowIdx[p]]-=L.values[p]*y[j];
+    // back substitution with U
+    for (size_t j=n; j-->0;)
+      {
+        y[j]/=U.values[U.colStart[j+1]-1];
+        for (size_t p=U.colStart[j]; p<U.colStart[j+1]-1; ++p)
+          y[U.rowIdx[p]]-=U.values[p]*y[j];
+      }
+    b.swap(y);
+  }
+}
@@ -0,0 +1,81 @@
+/*
+  @copyright Steve Keen 2019
+  @author Russell Standish
+  This file is part of Minsky.
+
+  Minsky is free software: you can redistribute it and/or modify it
+  under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Minsky is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Minsky.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef SPARSELU_H
+#define SPARSELU_H
+#include <vector>
+#include <stddef.h>
+
+namespace minsky
+{
+  /// square sparse matrix in compressed column format. Entries of
+  /// column j are rowIdx/values[colStart[j]..colStart[j+1])
+  struct SparseMatrix
+  {
+    size_t n=0;
+    std::vector<size_t> colStart{0}, rowIdx;
+    std::vector<double> values;
+    /// product of this with \a x
+    std::vector<double> operator*(const std::vector<double>& x) const;
+  };
+
+  /// LU factorisation with threshold partial pivoting of a sparse
+  /// matrix, by the left looking algorithm of Gilbert and Peierls, as
+  /// implemented in Tim Davis's CSparse. No column reordering is
+  /// performed.
+  class SparseLU
+  {
+    SparseMatrix L, U;
+    /// row i of the factored matrix is row pinv[i] of LU
+    std::vector<long> pinv;
+    /// inverse of pinv
+    std::vector<size_t> prow;
+    /// @{ symbolic analysis of the last factored matrix: its
+    /// sparsity pattern, and the nonzero pattern of L\A(:,k) in
+    /// topological order, being reachRows[reachStart[k]..reachStart[k+1])
+    std::vector<size_t> aColStart, aRowIdx, reachStart, reachRows;
+    bool factored=false;
+    /// @}
+    // workspace
+    std::vector<size_t> xi, stack;
+    std::vector<char> marked;
+    std::vector<double> x;
+    size_t reach(const SparseMatrix& A, size_t k);
+    size_t dfs(size_t j, size_t top);
+  public:
+    /// prefer the diagonal element as pivot if it is at least this
+    /// fraction of the largest candidate, to preserve sparsity
+    double pivotTolerance=0.1;
+    /// @return false if \a A is singular
+    bool factor(const SparseMatrix& A);
+    /// factor \a A, which has the same sparsity pattern as the last
+    /// factored matrix, reusing its pivot order and the structure of
+    /// its factors, so only the numerical values are computed.
+    /// @return false if \a A's pattern differs, or the previous
+    /// pivots are no longer acceptable, in which case factor() needs
+    /// to be called
+    bool refactor(const SparseMatrix& A);
+    /// solve Ax=b, where A is the last factored matrix, in place
+    void solve(std::vector<double>& b) const;
+    /// number of nonzeros in the factors
+    size_t nnz() const {return L.values.size()+U.values.size();}
+  };
+}
+
+#endif
@@ -39,6 +39,27 @@ namespace minsky
     return *this;
   }
   
+  void VariableValue::loadTensorInit() const
+  {
+    if (!deferredTensorInit) return;
+    auto& self=const_cast<VariableValue&>(*this);
+    TensorVal t;
+    XVectorVector xv;
+    try
+      {
+        deferredTensorInit->decode(t, xv);
+      }
+    catch (const std::exception& ex)
+      {
+        throw error("failed to decode tensor data for %s: %s", name.c_str(), ex.what());
+      }
+    self.deferredTensorInit.reset();
+    self.tensorInit=std::move(t);
+    self.setXVector(std::move(xv));
+    if (m_idx>=0 && tensorInit.data.size()==numElements())
+      self=tensorInit;
+  }
+  
   VariableValue& VariableValue::allocValue()
   {
     switch (m_type)
@@ -110,6 +131,7 @@ namespace minsky
   TensorVal VariableValue::initValue
   (const VariableValues& v, set<string>& visited) const
   {
+    loadTensorInit();
     if (!tensorInit.data.empty())
       return tensorInit;
     
@@ -195,25 +217,55 @@ namespace minsky
   void VariableValue::reset(const VariableValues& v)
   {
     if (m_idx<0) allocValue(); 
+    // tensor data of flow variables and parameters is decoded when
+    // the value is first used, see Minsky::constructEquations()
+    if (deferredTensorInit && isFlowVar()) return;
     operator=(initValue(v));
   }
 
 
-  int VariableValue::scope(const std::string& name) 
+  namespace
   {
-    boost::smatch m;
-    if (boost::regex_search(name, m, boost::regex(R"((\d*)]?:.*)")))
-      if (m.size()>1 && m[1].matched && !m[1].str().empty())
+    bool isDigit(char c) {return c>='0' && c<='9';}
+  }
+
+  // These are called for every variable whenever the model or its
+  // equations are constructed, so are hand coded rather than using
+  // regular expressions.
+
+  // matches (constant)?\d*:[^:\s\\{}]+, excluding a name of _
+  bool VariableValue::isValueId(const std::string& name)
+  {
+    if (name.length()<2 || name.compare(name.length()-2,2,":_")==0)
+      return false;
+    size_t i=name.compare(0,8,"constant")==0? 8: 0;
+    while (i<name.length() && isDigit(name[i])) ++i;
+    if (i==name.length() || name[i++]!=':' || i==name.length())
+      return false;
+    for (; i<name.length(); ++i)
+      switch (name[i])
         {
-          int r;
-          sscanf(m[1].str().c_str(),"%d",&r);
-          return r;
+        case ':': case '\\': case '{': case '}':
+        case ' ': case '\t': case '\n': case '\v': case '\f': case '\r':
+          return false;
         }
-      else
-        return -1;
-    else
+    return true;
+  }
+
+  // scope is the (possibly empty) string of digits immediately
+  // preceding the first ':', or the first ']:'
+  int VariableValue::scope(const std::string& name) 
+  {
+    auto end=name.find(':');
+    if (end==string::npos)
       // no scope information is present
       throw error("scope requested for local variable");
+    if (end>0 && name[end-1]==']') --end;
+    auto begin=end;
+    while (begin>0 && isDigit(name[begin-1])) --begin;
+    if (begin==end)
+      return -1;
+    return strtol(name.c_str()+begin, nullptr, 10);
   }
 
   GroupPtr VariableValue::scope(GroupPtr scope, const std::string& a_name)
@@ -272,9 +324,13 @@ namespace minsky
     // reallocate all variables
     ValueVector::stockVars.clear();
     ValueVector::flowVars.clear();
+    // allocate everything first, as initial values may refer to
+    // tensor data decoded, and so reallocated, during reset
     for (auto& v: *this)
-      v.second.allocValue().reset(*this);
-}
+      v.second.allocValue();
+    for (auto& v: *this)
+      v.second.reset(*this);
+  }
 
   bool VariableValues::validEntries() const
   {
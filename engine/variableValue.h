@@ -25,7 +25,6 @@
 #include "classdesc_access.h"
 #include "constMap.h"
 #include "str.h"
-#include <boost/regex.hpp>
 
 namespace minsky
 {
@@ -34,6 +33,16 @@ namespace minsky
   class Group;
   typedef std::shared_ptr<Group> GroupPtr;
 
+  /// tensor data attached to a variable as read from a saved model,
+  /// that is only decoded when first needed
+  struct DeferredTensorInit
+  {
+    virtual ~DeferredTensorInit() {}
+    /// decode the payload into \a tensorInit and \a xVector
+    /// @throw if the payload is corrupt
+    virtual void decode(TensorVal& tensorInit, std::vector<XVector>& xVector) const=0;
+  };
+
   // why are we doing this complicated mixin to constify the xVector
   // attribute instead of a simple const std::vector<XVector>&
   // VariableValue::xVector() const getter method?
@@ -95,6 +104,16 @@ namespace minsky
     std::string init;
     /// when init is a tensor of values, this overrides the init string
     TensorVal tensorInit;
+    /// encoded tensorInit data read from a file, pending
+    /// decoding. Whilst present, it overrides tensorInit, and is
+    /// saved back out as is.
+    classdesc::Exclude<std::shared_ptr<const DeferredTensorInit>> deferredTensorInit;
+    /// decode any tensor data deferred at load time into tensorInit
+    /// and xVector, discarding the encoded data, and set the value if
+    /// already allocated. Decoding only materialises data already
+    /// belonging to the value, so is allowed on a const value.
+    /// @throw if the encoded data is corrupt
+    void loadTensorInit() const;
 
     /// dimension units of this value
     Units units;
@@ -191,10 +210,7 @@ namespace minsky
     void reset(const VariableValues&); 
 
     /// check that name is a valid valueId (useful for assertions)
-    static bool isValueId(const std::string& name) {
-      return name.length()>1 && name.substr(name.length()-2)!=":_" &&
-        boost::regex_match(name, boost::regex(R"((constant)?\d*:[^:\s\\{}]+)"));
-    }
+    static bool isValueId(const std::string& name);
 
     /// construct a valueId
     static std::string valueId(int scope, std::string name) {
@@ -264,5 +280,15 @@ namespace minsky
 
 
 }
+
+#ifdef _CLASSDESC
+#pragma omit pack minsky::DeferredTensorInit
+#pragma omit unpack minsky::DeferredTensorInit
+#pragma omit TCL_obj minsky::DeferredTensorInit
+#pragma omit xml_pack minsky::DeferredTensorInit
+#pragma omit xml_unpack minsky::DeferredTensorInit
+#pragma omit xsd_generate minsky::DeferredTensorInit
+#endif
+
 #include "variableValue.cd"
 #endif
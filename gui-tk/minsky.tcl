@@ -410,6 +410,7 @@ menu .menubar.rungeKutta
 .menubar.rungeKutta add command -label "Runge Kutta" -command {
     foreach {var text} $rkVars { set rkVarInput($var) [$var] }
     set implicitSolver [implicit]
+    set integratorMethod [integrator]
     deiconifyRKDataForm
     update idletasks
     ::tk::TabToWindow $rkVarInput(initial_focus)
@@ -417,6 +418,7 @@ menu .menubar.rungeKutta
     grab set .rkDataForm
     wm transient .rkDataForm .
 } -underline 0 
+.menubar.rungeKutta add command -label "Find steady state" -command {minsky.findSteadyState 1e-8 500}
 .menubar add cascade -label "Runge Kutta" -menu .menubar.rungeKutta
 
 # special platform specific menus
@@ -663,6 +665,7 @@ proc logVarsOK {} {
 .menubar.edit add command -label "Cut" -command cut -accelerator $meta_menu-X
 .menubar.edit add command -label "Copy" -command minsky.copy -accelerator $meta_menu-C
 .menubar.edit add command -label "Paste" -command {paste} -accelerator $meta_menu-V
+.menubar.edit add command -label "Duplicate" -command {minsky.duplicateSelection} -accelerator $meta_menu-D
 .menubar.edit add command -label "Group selection" -command "minsky.createGroup" -accelerator $meta_menu-G
 .menubar.edit add command -label "Dimensions" -command dimensionsDialog
 
@@ -753,6 +756,7 @@ bind . <$meta-z> "undo 1"
 bind . <$meta-x> {minsky.cut}
 bind . <$meta-c> {minsky.copy}
 bind . <$meta-v> {paste}
+bind . <$meta-d> {minsky.duplicateSelection}
 bind . <$meta-g> {minsky.createGroup}
 
 # tabbed manager
@@ -1146,7 +1150,7 @@ proc save {} {
                   -filetypes {{"Minsky" .mky TEXT} {"All Files" * TEXT}}]}            
     if [string length $fname] {
         set workDir [file dirname $fname]
-        eval minsky.save {$fname}
+        saveInBackground $fname
     }
 }
 
@@ -1156,15 +1160,40 @@ proc saveAs {} {
               -filetypes {{"Minsky" .mky TEXT} {"All Files" * TEXT}}]
     if [string length $fname] {
         set workDir [file dirname $fname]
-        eval minsky.save {$fname}
+        saveInBackground $fname
+    }
+}
+
+# write the model out on a worker thread, and poll for its completion
+proc saveInBackground {fname} {
+    if [catch {minsky.saveInBackground $fname 0} err] {
+        tk_messageBox -icon error -message "Save failed: $err"
+        return
+    }
+    pollBackgroundSave
+}
+
+proc pollBackgroundSave {} {
+    if [catch {minsky.pollBackgroundSave} done] {
+        tk_messageBox -icon error -message "Save failed: $done"
+    } elseif {!$done} {
+        after 100 pollBackgroundSave
+    }
+}
+
+# block until any background save has been written out
+proc waitForBackgroundSave {} {
+    if [catch {minsky.waitForBackgroundSave} err] {
+        tk_messageBox -icon error -message "Save failed: $err"
     }
 }
 
 proc newSystem {} {
     doPushHistory 0
+    waitForBackgroundSave
     if [edited] {
         switch [tk_messageBox -message "Save?" -type yesnocancel] {
-            yes save
+            yes {save; waitForBackgroundSave}
             no {}
             cancel {return -level [info level]}
         }
@@ -1241,6 +1270,10 @@ proc deiconifyRKDataForm {} {
         }
         grid [label .rkDataForm.implicitlabel -text "Implicit solver"] -column 10 -row $row -sticky e
         grid [checkbutton  .rkDataForm.implicitcheck -variable implicitSolver -command toggleImplicitSolver] -column 20 -row $row -sticky ew
+        incr row 10
+        grid [label .rkDataForm.integratorlabel -text "Explicit integrator"] -column 10 -row $row -sticky e
+        tk_optionMenu .rkDataForm.integrator integratorMethod gslIntegrator rk4 dormandPrince54 lowStorageRK4
+        grid .rkDataForm.integrator -column 20 -row $row -sticky ew
 
         set rkVarInput(initial_focus) ".rkDataForm.text$rowdict(Min Step Size)"
         frame .rkDataForm.buttonBar
@@ -1268,8 +1301,9 @@ proc closeRKDataForm {} {
 }
 
 proc setRKparms {} {
-    global rkVars rkVarInput
+    global rkVars rkVarInput integratorMethod
     foreach {var text} $rkVars { $var $rkVarInput($var) }
+    integrator $integratorMethod
 }
 
 
@@ -1422,9 +1456,10 @@ proc deleteSubsidiaryTopLevels {} {
 
 proc exit {} {
     # check if the model has been saved yet
+    waitForBackgroundSave
     if [edited] {
         switch [tk_messageBox -message "Save before exiting?" -type yesnocancel] {
-            yes save
+            yes {save; waitForBackgroundSave}
             no {}
             cancel {return -level [info level]}
         }
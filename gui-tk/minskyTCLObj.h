@@ -52,6 +52,26 @@ namespace minsky
               gtw->pushHistory();
         return;
       }
+    // cached icons remain valid whilst panning, zooming, hovering
+    // and simulating, but any other command may alter an item
+    if (argv0!="minsky.canvas.mouseMove" &&
+        argv0!="minsky.canvas.requestRedraw" &&
+        argv0!="minsky.canvas.model.moveTo" &&
+        argv0!="minsky.canvas.model.zoom" &&
+        argv0!="minsky.model.moveTo" &&
+        argv0!="minsky.model.zoom" &&
+        argv0!="minsky.step" &&
+        argv0!="minsky.running" &&
+        argv0!="minsky.saveInBackground" &&
+        argv0!="minsky.pollBackgroundSave" &&
+        argv0!="minsky.waitForBackgroundSave" &&
+        argv0.find("minsky.panopticon")==string::npos &&
+        argv0.find("minsky.equationDisplay")==string::npos)
+      {
+        auto t=getCommandData(argv0);
+        if (!t || (!t->is_const && (!t->is_setterGetter || argc>1)))
+          m.canvas.clearIconCache();
+      }
     if (m.doPushHistory &&
         argv0!="minsky.availableOperations" &&
         argv0!="minsky.canvas.select" &&
@@ -75,6 +95,9 @@ namespace minsky
         argv0!="minsky.setGroupIconResource" &&
         argv0!="minsky.step" &&
         argv0!="minsky.running" &&
+        argv0!="minsky.saveInBackground" &&
+        argv0!="minsky.pollBackgroundSave" &&
+        argv0!="minsky.waitForBackgroundSave" &&
         argv0.find("minsky.panopticon")==string::npos &&
         argv0.find("minsky.equationDisplay")==string::npos && 
         argv0.find(".get")==string::npos && 
@@ -87,7 +110,14 @@ namespace minsky
           {
             //            cmdHist[argv0]++;
             bool modelChanged=m.pushHistory();
-            if (modelChanged && argv0!="minsky.load" && argv0!="minsky.reverse") m.markEdited();
+            if (modelChanged && argv0!="minsky.load" && argv0!="minsky.reverse")
+              {
+                // changes to parameter values alone do not require a reset
+                if (m.historyStructureChanged())
+                  m.markEdited();
+                else
+                  m.markParametersEdited();
+              }
             if (m.eventRecord.get() && argv0!="minsky.startRecording" &&
                 (modelChanged || argv0.find("minsky.canvas.mouse")!=string::npos))
               {
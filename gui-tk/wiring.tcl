@@ -494,6 +494,7 @@ proc canvasContext {x y X Y} {
     .wiring.context add command -label "Copy" -command minsky.copy
     .wiring.context add command -label "Save selection as" -command saveSelection
     .wiring.context add command -label "Paste" -command {paste}
+    .wiring.context add command -label "Duplicate" -command {minsky.duplicateSelection}
     .wiring.context add command -label "Bookmark here" -command "bookmarkAt $x $y $X $Y"
     .wiring.context add command -label "Group" -command "minsky.createGroup"
     .wiring.context add command -label "Lock selected Ravels" -command "minsky.canvas.lockRavelsInSelection"
@@ -946,7 +947,12 @@ proc deiconifyEditVar {} {
             $item.sliderStep  $editVarInput(Slider Step Size)
             $item.sliderStepRel  $editVarInput(relative)
             makeVariablesConsistent
-            catch reset
+            # a change of parameter value need not interrupt the simulation
+            if {[minsky.historyStructureChanged]} {
+                catch reset
+            } else {
+                minsky.markParametersEdited
+            }
             closeEditWindow .wiring.editVar
         }
         # adjust "Slider Step Size" row to include "relative" radiobutton
@@ -121,7 +121,7 @@ RenderVariable::RenderVariable(const VariableBase& var, cairo_t* cairo):
     }
   else
     {
-      setMarkup(latexToPango(var.name()));
+      setMarkup(var.nameMarkup());
       w=0.5*Pango::width(); 
       h=0.5*Pango::height();
       if (!var.ioVar())
@@ -158,11 +158,14 @@ bool RenderVariable::inImage(float x, float y)
   return rx>=-w && rx<=w && ry>=-h && ry <= h;
 }
 
-double RenderVariable::handlePos() const
+double RenderVariable::handlePos(const VariableBase& var, float w)
 {
   var.initSliderBounds();
   var.adjustSliderBounds();
-  return w*(var.value()-0.5*(var.sliderMin+var.sliderMax))/(var.sliderMax-var.sliderMin);
+  // refer to the value in place, as this is called every frame
+  auto vv=var.vValue();
+  double v=vv? vv->value(): 0;
+  return w*(v-0.5*(var.sliderMin+var.sliderMax))/(var.sliderMax-var.sliderMin);
 }
 
 void minsky::drawTriangle
@@ -74,7 +74,10 @@ namespace minsky
     bool inImage(float x, float y); ///< true if (x,y) within rendered image
     /// x coordinate of the slider handle in the unrotated/unscaled
     /// frame of reference
-    double handlePos() const;
+    double handlePos() const {return handlePos(var, w);}
+    /// as handlePos(), for variable \a var rendered with half width
+    /// \a w, without laying out its text
+    static double handlePos(const VariableBase& var, float w);
   };
 
   void drawTriangle(cairo_t* cairo, double x, double y, const ecolab::cairo::Colour& col, double angle=0);
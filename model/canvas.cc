@@ -31,6 +31,72 @@ using namespace minsky;
 
 namespace minsky
 {
+  namespace
+  {
+    /// first item of \a g or its subgroups near (x,y) satisfying \a
+    /// c, in the order searched by GroupItems::findAny
+    template <class C>
+    ItemPtr findItemAt(const Group& g, float x, float y, C c)
+    {
+      // items of groups not displaying their contents are not visible
+      if (g.displayContents())
+        for (auto& i: g.spatialIndex.itemsAt(g,x,y))
+          if (c(i))
+            return i;
+      for (auto& sg: g.groups)
+        if (auto i=findItemAt(*sg,x,y,c))
+          return i;
+      return nullptr;
+    }
+
+    /// first wire of \a g or its subgroups near (x,y)
+    WirePtr findWireAt(const Group& g, float x, float y)
+    {
+      for (auto& w: g.spatialIndex.wiresAt(g,x,y))
+        if (w->near(x,y))
+          return w;
+      for (auto& sg: g.groups)
+        if (auto w=findWireAt(*sg,x,y))
+          return w;
+      return nullptr;
+    }
+
+    /// append items of \a g and its subgroups that may be under (x,y)
+    void itemsAt(const Group& g, float x, float y, vector<ItemPtr>& r)
+    {
+      auto items=g.spatialIndex.itemsAt(g,x,y);
+      r.insert(r.end(), items.begin(), items.end());
+      for (auto& sg: g.groups)
+        itemsAt(*sg,x,y,r);
+    }
+
+    /// append wires of \a g and its subgroups that may be near (x,y)
+    void wiresAt(const Group& g, float x, float y, vector<WirePtr>& r)
+    {
+      auto wires=g.spatialIndex.wiresAt(g,x,y);
+      r.insert(r.end(), wires.begin(), wires.end());
+      for (auto& sg: g.groups)
+        wiresAt(*sg,x,y,r);
+    }
+
+    /// live objects of \a prev followed by those of \a cur, without duplicates
+    template <class T>
+    vector<shared_ptr<T>> hoverCandidates(const vector<weak_ptr<T>>& prev,
+                                          vector<shared_ptr<T>>&& cur)
+    {
+      vector<shared_ptr<T>> r;
+      unordered_set<T*> seen;
+      for (auto& i: prev)
+        if (auto p=i.lock())
+          if (seen.insert(p.get()).second)
+            r.push_back(p);
+      for (auto& i: cur)
+        if (seen.insert(i.get()).second)
+          r.push_back(i);
+      return r;
+    }
+  }
+
   void Canvas::mouseDown(float x, float y)
   {
     // firstly, see if the user is selecting an item
@@ -82,8 +148,7 @@ namespace minsky
       }
     else
       {
-        wireFocus=model->findAny(&Group::wires,
-                       [&](const WirePtr& i){return i->near(x,y);});
+        wireFocus=findWireAt(*model,x,y);
         if (wireFocus)
           handleSelected=wireFocus->nearestHandle(x,y);
         else
@@ -102,19 +167,31 @@ namespace minsky
   {
     shared_ptr<Port> closestPort;
     auto minD=numeric_limits<float>::max();
-    model->recursiveDo(&GroupItems::items,
-                       [&](const Items&, Items::const_iterator i)
+    // distance within which ports are sought
+    auto bound=numeric_limits<float>::infinity();
+    auto search=[&](const Group& g)
+                {
+                  if (g.displayContents())
+                    g.spatialIndex.nearestItems
+                      (g, x, y, bound, [&](const ItemPtr& i)
                        {
-                         if ((*i)->group.lock()->displayContents())
-                           for (auto& p: (*i)->ports)
-                             {
-                               float d=sqr(p->x()-x)+sqr(p->y()-y);
-                               if (d<minD)
-                                 {
-                                   minD=d;
-                                   closestPort=p;
-                                 }
-                             }
+                         for (auto& p: i->ports)
+                           {
+                             float d=sqr(p->x()-x)+sqr(p->y()-y);
+                             if (d<minD)
+                               {
+                                 minD=d;
+                                 closestPort=p;
+                                 bound=sqrt(d);
+                               }
+                           }
+                       });
+                };
+    search(*model);
+    model->recursiveDo(&GroupItems::groups,
+                       [&](const Groups&, Groups::const_iterator i)
+                       {
+                         search(**i);
                          return false;
                        });
     return closestPort;
@@ -209,6 +286,8 @@ namespace minsky
                     double rw=fabs(v->zoomFactor()*rv.width()*cos(v->rotation*M_PI/180));
                     v->sliderSet((x-v->x()) * (v->sliderMax-v->sliderMin) /
                                  rw + 0.5*(v->sliderMin+v->sliderMax));
+                    if (v->type()==VariableType::parameter)
+                      minsky().markParameterValueSet();
                     // push History to prevent an unnecessary reset when
                     // adjusting the slider whilst paused. See ticket #812
                     minsky().pushHistory();
@@ -261,49 +340,57 @@ namespace minsky
           }
         else
           {
-            // set mouse focus to display ports etc.
-            model->recursiveDo(&Group::items, [&](Items&,Items::iterator& i)
-                                              {
-                                                (*i)->disableDelayedTooltip();
-                                                // with coupled integration variables, we
-                                                // do not want to set mousefocus, as this
-                                                // draws unnecessary port circles on the
-                                                // variable
-                                                if (!(*i)->visible() && 
-                                                    dynamic_cast<Variable<VariableBase::integral>*>(i->get()))
-                                                  (*i)->mouseFocus=false;
-                                                else
-                                                  {
-                                                    auto ct=(*i)->clickType(x,y);
-                                                    if (ct==ClickType::onRavel)
-                                                      {
-                                                        if (auto r=dynamic_cast<Ravel*>(i->get()))
-                                                          {
-                                                            r->mouseFocus=true;
-                                                            r->onBorder = false;
-                                                            if (r->onMouseOver(x,y))
-                                                              requestRedraw();
-                                                          }
-                                                      }
-                                                    else
-                                                      {
-                                                        auto mf = ct!=ClickType::outside;
-                                                        if ((*i)->mouseFocus!=mf)
-                                                          {
-                                                            requestRedraw();
-                                                            (*i)->mouseFocus=mf;
-                                                          }
-                                                        (*i)->onResizeHandles=ct==ClickType::onResize;
-                                                        if (auto r=dynamic_cast<Ravel*>(i->get()))
-                                                          {
-                                                            r->onBorder = ct==ClickType::onItem;
-                                                            r->onMouseLeave();
-                                                            requestRedraw();
-                                                          }
-                                                      }
-                                                  }
-                                                return false;
-                                              });
+            // set mouse focus to display ports etc. Only items that
+            // may be under the mouse, or that were focused by the
+            // previous move, need examining.
+            vector<ItemPtr> under;
+            itemsAt(*model,x,y,under);
+            auto items=hoverCandidates(hoverItems,move(under));
+            hoverItems.clear();
+            for (auto& i: items)
+              {
+                i->disableDelayedTooltip();
+                // with coupled integration variables, we
+                // do not want to set mousefocus, as this
+                // draws unnecessary port circles on the
+                // variable
+                if (!i->visible() && 
+                    dynamic_cast<Variable<VariableBase::integral>*>(i.get()))
+                  i->mouseFocus=false;
+                else
+                  {
+                    auto ct=i->clickType(x,y);
+                    if (ct==ClickType::onRavel)
+                      {
+                        if (auto r=dynamic_cast<Ravel*>(i.get()))
+                          {
+                            r->mouseFocus=true;
+                            r->onBorder = false;
+                            if (r->onMouseOver(x,y))
+                              requestRedraw();
+                          }
+                      }
+                    else
+                      {
+                        auto mf = ct!=ClickType::outside;
+                        if (i->mouseFocus!=mf)
+                          {
+                            requestRedraw();
+                            i->mouseFocus=mf;
+                          }
+                        i->onResizeHandles=ct==ClickType::onResize;
+                        if (auto r=dynamic_cast<Ravel*>(i.get()))
+                          {
+                            r->onBorder = ct==ClickType::onItem;
+                            r->onMouseLeave();
+                            requestRedraw();
+                          }
+                      }
+                  }
+                auto r=dynamic_cast<Ravel*>(i.get());
+                if (i->mouseFocus || i->onResizeHandles || (r && r->onBorder))
+                  hoverItems.push_back(i);
+              }
             model->recursiveDo(&Group::groups, [&](Groups&,Groups::iterator& i)
                                                {
                                                  bool mf=(*i)->contains(x,y) && !(*i)->displayContents();
@@ -320,16 +407,21 @@ namespace minsky
                                                    }
                                                  return false;
                                                });
-            model->recursiveDo(&Group::wires, [&](Wires&,Wires::iterator& i)
-                                              {
-                                                bool mf=(*i)->near(x,y);
-                                                if (mf!=(*i)->mouseFocus)
-                                                  {
-                                                    (*i)->mouseFocus=mf;
-                                                    requestRedraw();
-                                                  }        
-                                                return false;
-                                              });
+            vector<WirePtr> nearMouse;
+            wiresAt(*model,x,y,nearMouse);
+            auto wires=hoverCandidates(hoverWires,move(nearMouse));
+            hoverWires.clear();
+            for (auto& w: wires)
+              {
+                bool mf=w->near(x,y);
+                if (mf!=w->mouseFocus)
+                  {
+                    w->mouseFocus=mf;
+                    requestRedraw();
+                  }
+                if (mf)
+                  hoverWires.push_back(w);
+              }
           }
       }
     catch (...) {/* absorb any exceptions, as they're not useful here */}
@@ -351,7 +443,8 @@ namespace minsky
 
     if (!topLevel) topLevel=&*model;
 
-    for (auto& i: topLevel->items)
+    SpatialBox box(lasso.x0,lasso.y0,lasso.x1,lasso.y1);
+    for (auto& i: topLevel->spatialIndex.itemsIn(*topLevel,box))
       if (i->visible() && lasso.intersects(*i))
         {
           selection.items.push_back(i);
@@ -371,7 +464,7 @@ namespace minsky
           i->selected=true;
         }
 
-    for (auto& i: topLevel->wires)
+    for (auto& i: topLevel->spatialIndex.wiresIn(*topLevel,box))
       if (i->visible() && lasso.contains(*i))
         selection.wires.push_back(i);
 
@@ -381,8 +474,8 @@ namespace minsky
   
   ItemPtr Canvas::itemAt(float x, float y)
   {
-    auto item=model->findAny(&Group::items,
-                        [&](const ItemPtr& i){return i->visible() && i->contains(x,y);});
+    auto item=findItemAt(*model, x, y,
+                         [&](const ItemPtr& i){return i->visible() && i->contains(x,y);});
     if (!item)
       item=model->findAny
         (&Group::groups, [&](const GroupPtr& i)
@@ -392,8 +485,7 @@ namespace minsky
   
   void Canvas::getWireAt(float x, float y)
   {
-    wire=model->findAny(&Group::wires,
-                        [&](const WirePtr& i){return i->near(x,y);});
+    wire=findWireAt(*model,x,y);
   }
 
   void Canvas::groupSelection()
@@ -699,6 +791,46 @@ namespace minsky
     redraw(-1e9,-1e9,2e9,2e9);
   }
 
+  void Canvas::drawItem(cairo_t* cairo, const ItemPtr& item)
+  {
+    auto& it=*item;
+    if (!it.iconCacheable())
+      {
+        it.draw(cairo);
+        return;
+      }
+    auto& c=iconCache[&it];
+    float z=it.zoomFactor();
+    if (!c.surface || c.item.lock()!=item || c.zoom!=z || c.rotation!=it.rotation ||
+        c.mouseFocus!=it.mouseFocus || c.selected!=it.selected ||
+        c.onResizeHandles!=it.onResizeHandles)
+      {
+        c.item=item;
+        c.zoom=z;
+        c.rotation=it.rotation;
+        c.mouseFocus=it.mouseFocus;
+        c.selected=it.selected;
+        c.onResizeHandles=it.onResizeHandles;
+        c.surface.reset(new Surface
+                        (cairo_recording_surface_create(CAIRO_CONTENT_COLOR_ALPHA,nullptr)));
+        cairo_set_line_width(c.surface->cairo(), cairo_get_line_width(cairo));
+        it.drawIcon(c.surface->cairo());
+        c.ports.clear();
+        for (auto& p: it.ports)
+          c.ports.emplace_back(p->x()-it.x(), p->y()-it.y());
+      }
+    else
+      // ports may since have been moved, eg by drawSimplified()
+      for (size_t i=0; i<c.ports.size() && i<it.ports.size(); ++i)
+        it.ports[i]->moveTo(it.x()+c.ports[i].first, it.y()+c.ports[i].second);
+    {
+      CairoSave cs(cairo);
+      cairo_set_source_surface(cairo, c.surface->surface(), 0, 0);
+      cairo_paint(cairo);
+    }
+    it.drawDynamic(cairo);
+  }
+
   void Canvas::redrawUpdateRegion()
   {
     if (!surface.get()) return;
@@ -707,6 +839,38 @@ namespace minsky
     cairo_rectangle(cairo,updateRegion.x0,updateRegion.y0,updateRegion.x1-updateRegion.x0,updateRegion.y1-updateRegion.y0);
     cairo_clip(cairo);
     cairo_set_line_width(cairo, 1);
+    if (model.timestamp>iconCacheCheck)
+      {
+        iconCache.clear();
+        iconCacheCheck=Timestamp::clock::now();
+      }
+    // runs of items too small to show any detail, with the same
+    // selection state, are filled together, in the order the items
+    // would otherwise be drawn
+    bool simplifiedPending=false, simplifiedSelected=false;
+    auto fillSimplified=[&]() {
+      if (!simplifiedPending) return;
+      cairo_save(cairo);
+      if (simplifiedSelected)
+        cairo_set_source_rgb(cairo,0.3,0.3,0.8);
+      else
+        cairo_set_source_rgb(cairo,0.6,0.6,0.6);
+      cairo_fill(cairo);
+      cairo_restore(cairo);
+      simplifiedPending=false;
+    };
+    auto drawSimplified=[&](const Item& it) {
+      if (it.selected!=simplifiedSelected)
+        fillSimplified();
+      simplifiedSelected=it.selected;
+      cairo_save(cairo);
+      cairo_identity_matrix(cairo);
+      cairo_translate(cairo,it.x(), it.y());
+      it.drawSimplified(cairo);
+      cairo_restore(cairo);
+      simplifiedPending=true;
+    };
+    
     // items
     model->recursiveDo
       (&GroupItems::items, [&](const Items&, Items::const_iterator i)
@@ -714,10 +878,16 @@ namespace minsky
          auto& it=**i;
          if (it.visible() && updateRegion.intersects(it))
            {
+             if (simplified(it))
+               {
+                 drawSimplified(it);
+                 return false;
+               }
+             fillSimplified();
              cairo_save(cairo);
              cairo_identity_matrix(cairo);
              cairo_translate(cairo,it.x(), it.y());
-             it.draw(cairo);
+             drawItem(cairo,*i);
              cairo_restore(cairo);
            }
          return false;
@@ -730,6 +900,12 @@ namespace minsky
          auto& it=**i;
          if (it.visible() && updateRegion.intersects(it))
            {
+             if (simplified(it))
+               {
+                 drawSimplified(it);
+                 return false;
+               }
+             fillSimplified();
              cairo_save(cairo);
              cairo_identity_matrix(cairo);
              cairo_translate(cairo,it.x(), it.y());
@@ -739,16 +915,39 @@ namespace minsky
          return false;
        });
 
+    fillSimplified();
+
     // draw all wires - wires will go over the top of any icons. TODO
-    // introduce an ordering concept if needed
+    // introduce an ordering concept if needed. Wires attached to
+    // simplified items are drawn as plain polylines.
+    vector<const Wire*> detailedWires, simplifiedWires;
     model->recursiveDo
       (&GroupItems::wires, [&](const Wires&, Wires::const_iterator i)
        {
          const Wire& w=**i;
          if (w.visible()/* && updateRegion.intersects(w)*/)
-           w.draw(cairo);
+           {
+             auto from=w.from(), to=w.to();
+             if ((from && simplified(from->item)) || (to && simplified(to->item)))
+               simplifiedWires.push_back(&w);
+             else
+               detailedWires.push_back(&w);
+           }
          return false;
        });
+    // all wires share the same style, so are stroked, and their
+    // arrowheads filled, in single operations
+    for (auto w: detailedWires)
+      w->addPath(cairo);
+    for (auto w: simplifiedWires)
+      w->drawSimplified(cairo);
+    cairo_stroke(cairo);
+    for (auto w: detailedWires)
+      w->addArrowhead(cairo);
+    cairo_fill(cairo);
+    for (auto w: detailedWires)
+      if (w->mouseFocus)
+        w->drawHandles(cairo);
 
     if (fromPort.get()) // we're in process of creating a wire
       {
@@ -31,6 +31,7 @@
 #include <cairoSurfaceImage.h>
 
 #include <chrono>
+#include <unordered_map>
 
 namespace minsky
 {
@@ -51,6 +52,30 @@ namespace minsky
     void reportDrawTime(double) override;
   public:
     typedef std::chrono::time_point<std::chrono::high_resolution_clock> Timestamp;
+  private:
+    /// @{ items and wires given mouse focus by the last mouseMove,
+    /// which need revisiting once the mouse has moved away
+    Exclude<std::vector<std::weak_ptr<Item>>> hoverItems;
+    Exclude<std::vector<std::weak_ptr<Wire>>> hoverWires;
+    /// @}
+
+    /// rendering of an item's icon, replayed by redrawUpdateRegion()
+    /// whilst the item's appearance is unchanged
+    struct CachedIcon
+    {
+      std::weak_ptr<Item> item;
+      ecolab::cairo::SurfacePtr surface;
+      float zoom=0;
+      double rotation=0;
+      bool mouseFocus=false, selected=false, onResizeHandles=false;
+      /// port positions relative to the item, as set by drawIcon()
+      std::vector<std::pair<float,float>> ports;
+    };
+    Exclude<std::unordered_map<const Item*, CachedIcon>> iconCache;
+    Exclude<Timestamp> iconCacheCheck;
+    /// draw \a item, using its cached icon if possible
+    void drawItem(cairo_t*, const ItemPtr& item);
+  public:
     struct Model: public GroupPtr
     {
       Exclude<Timestamp> timestamp{Timestamp::clock::now()};
@@ -105,6 +130,14 @@ namespace minsky
     LassoBox lasso{0,0,0,0};
 
     bool redrawAll=true; ///< if false, then only redraw graphs
+    /// items smaller than this on screen (in pixels) are drawn as
+    /// plain shapes without text or ports, and wires attached to them
+    /// as straight polylines
+    float minDetailSize=8;
+    /// true if \a item is too small on screen to be drawn in detail
+    bool simplified(const Item& item) const {
+      return item.zoomFactor()*std::max(item.width(),item.height())<minDetailSize;
+    }
     
     Canvas() {}
     Canvas(const GroupPtr& m): model(m) {}
@@ -228,6 +261,9 @@ namespace minsky
     LassoBox updateRegion{0,0,0,0};
     /// update region given by updateRegion
     void redrawUpdateRegion();
+    /// discard cached item icons. Called whenever an item's
+    /// appearance may have changed other than by moving or zooming.
+    void clearIconCache() {iconCache.clear();}
 
     /// adjust canvas so that -ve coordinates appear on canvas
     void recentre();
@@ -237,5 +273,14 @@ namespace minsky
   };
 }
 
+#ifdef _CLASSDESC
+#pragma omit pack minsky::Canvas::CachedIcon
+#pragma omit unpack minsky::Canvas::CachedIcon
+#pragma omit TCL_obj minsky::Canvas::CachedIcon
+#pragma omit xml_pack minsky::Canvas::CachedIcon
+#pragma omit xml_unpack minsky::Canvas::CachedIcon
+#pragma omit xsd_generate minsky::Canvas::CachedIcon
+#endif
+
 #include "canvas.cd"
 #endif
@@ -128,7 +128,7 @@ namespace minsky
   }
 
 
-  void GodleyTableWindow::redraw(int, int, int, int)
+  void GodleyTableWindow::redraw(int, int y0, int, int height)
   {
     if (!godleyIcon) return;
     CairoSave cs(surface->cairo());
@@ -137,6 +137,22 @@ namespace minsky
     ZoomablePango pango(surface->cairo());
     pango.setMarkup("Flows ↓ / Stock Vars →");
     rowHeight=pango.height()+2;
+    double cornerWidth=pango.width();
+    // rows outside the region being drawn need only be measured. A
+    // zero height (eg vector rendering) draws all rows.
+    double visibleTop=height>0? y0/zoomFactor: -numeric_limits<double>::max();
+    double visibleBottom=height>0? (y0+height)/zoomFactor: numeric_limits<double>::max();
+    // cached layouts are indexed by position, so are discarded when
+    // rows or columns are added, removed or moved
+    if (cellLayoutZoom!=zoomFactor || cellLayoutRows!=godleyIcon->table.rows() ||
+        cellLayoutCols!=godleyIcon->table.cols())
+      {
+        cellLayouts.clear();
+        rowSumLayouts.clear();
+        cellLayoutZoom=zoomFactor;
+        cellLayoutRows=godleyIcon->table.rows();
+        cellLayoutCols=godleyIcon->table.cols();
+      }
     double tableHeight=(godleyIcon->table.rows()-scrollRowStart+1)*rowHeight;
     double x=leftTableOffset;
     double lastAssetBoundary=x;
@@ -190,68 +206,94 @@ namespace minsky
           {
             if (row>0 && row<scrollRowStart) continue;
 
-            if (col==0 && row>0 && col<rowWidgets.size())
+            bool visible=y+rowHeight>visibleTop && y<visibleBottom;
+            if (visible && col==0 && row>0 && col<rowWidgets.size())
               {
                 CairoSave cs(surface->cairo());
                 cairo_move_to(surface->cairo(), 0, y);
                 rowWidgets[row].draw(surface->cairo());
               }
             
-            CairoSave cs(surface->cairo());
-            if (row!=0 || col!=0)
+            auto& layout=cellLayouts[make_pair(row,col)];
+            if (row==0 && col==0)
               {
-                string text=godleyIcon->table.cell(row,col);
-                if (!text.empty())
+                layout.markup="Flows ↓ / Stock Vars →";
+                layout.width=cornerWidth;
+              }
+            else
+              {
+                auto& text=godleyIcon->table.cell(row,col);
+                bool selected=int(row)==selectedRow && int(col)==selectedCol;
+                string value;
+                if (displayValues && !text.empty())
                   {
-                    string value;
                     FlowCoef fc(text);
-                    if (displayValues)
+                    auto& values=cminsky().variableValues;
+                    auto vv=values.find
+                      (VariableValue::valueIdFromScope(godleyIcon->group.lock(),fc.name));
+                    if (vv!=values.end() && vv->second.idx()>=0)
                       {
-                        auto vv=cminsky().variableValues
-                          [VariableValue::valueIdFromScope
-                           (godleyIcon->group.lock(),fc.name)];
-                        if (vv.idx()>=0)
-                          {
-                            double val=fc.coef*vv.value();
-                            auto ee=engExp(val);
-                            if (ee.engExp==-3) ee.engExp=0;
-                            value=" = "+mantissa(val,ee)+expMultiplier(ee.engExp);
-                          }
+                        double val=fc.coef*vv->second.value();
+                        auto ee=engExp(val);
+                        if (ee.engExp==-3) ee.engExp=0;
+                        value=" = "+mantissa(val,ee)+expMultiplier(ee.engExp);
                       }
-                    // the active cell renders as bare LaTeX code for
-                    // editing, all other cells rendered as LaTeX
-                    if (int(row)!=selectedRow || int(col)!=selectedCol)
+                  }
+                // cell text is only laid out again if it or the way
+                // it is displayed has changed
+                string key=text+'\0'+value+'\0'+to_string(selected)+
+                  to_string(displayStyle)+to_string(assetClass);
+                if (layout.key!=key)
+                  {
+                    layout.key=key;
+                    layout.negative=false;
+                    string markup;
+                    if (!text.empty())
                       {
-                        if (row>0 && col>0 && !godleyIcon->table.initialConditionRow(row))
-                          { // handle DR/CR mode and colouring of text
-                            if (fc.coef<0)
-                              cairo_set_source_rgb(surface->cairo(),1,0,0);
-                            if (displayStyle==DRCR)
-                              {
-                                if (assetClass==GodleyAssetClass::asset ||
-                                    assetClass==GodleyAssetClass::noAssetClass)
-                                  text = (fc.coef<0)?"CR ":"DR ";
+                        // the active cell renders as bare LaTeX code for
+                        // editing, all other cells rendered as LaTeX
+                        if (!selected)
+                          {
+                            if (row>0 && col>0 && !godleyIcon->table.initialConditionRow(row))
+                              { // handle DR/CR mode and colouring of text
+                                FlowCoef fc(text);
+                                layout.negative=fc.coef<0;
+                                if (displayStyle==DRCR)
+                                  {
+                                    if (assetClass==GodleyAssetClass::asset ||
+                                        assetClass==GodleyAssetClass::noAssetClass)
+                                      markup = (fc.coef<0)?"CR ":"DR ";
+                                    else
+                                      markup = (fc.coef<0)?"DR ":"CR ";
+                                    fc.coef=abs(fc.coef);
+                                    markup+=latexToPango(fc.str());
+                                  }
                                 else
-                                  text = (fc.coef<0)?"DR ":"CR ";
-                                fc.coef=abs(fc.coef);
-                                text+=latexToPango(fc.str());
+                                  markup = latexToPango(text);
                               }
-                            else
-                              text = latexToPango(text);
+                            else // is flow tag, stock var or initial condition
+                              markup = latexToPango(text);
+                            markup+=value;
                           }
-                        else // is flow tag, stock var or initial condition
-                          text = latexToPango(text);
-                        text+=value;
+                        else
+                          markup=defang(text);
                       }
-                    else
-                      text=defang(text);
+                    layout.markup=markup;
+                    pango.setMarkup(markup);
+                    layout.width=pango.width();
                   }
-                pango.setMarkup(text);
               }
             // allow extra space for the ▼ in row 0
-            colWidth=max(colWidth,pango.width() + (row==0? pulldownHot:0));
-            cairo_move_to(surface->cairo(),x+3,y);
-            pango.show();
+            colWidth=max(colWidth,layout.width + (row==0? pulldownHot:0));
+            if (visible)
+              {
+                CairoSave cs(surface->cairo());
+                if (layout.negative)
+                  cairo_set_source_rgb(surface->cairo(),1,0,0);
+                pango.setMarkup(layout.markup);
+                cairo_move_to(surface->cairo(),x+3,y);
+                pango.show();
+              }
             y+=rowHeight;
           }
         y=topTableOffset;
@@ -293,10 +335,22 @@ namespace minsky
     for (unsigned row=1; row<godleyIcon->table.rows(); ++row)
       {
         if (row>0 && row<scrollRowStart) continue;
-        pango.setMarkup(latexToPango(godleyIcon->table.rowSum(row)));
-        colWidth=max(colWidth,pango.width());
-        cairo_move_to(surface->cairo(),x,y);
-        pango.show();
+        auto& layout=rowSumLayouts[row];
+        string key=godleyIcon->table.rowSum(row);
+        if (layout.key!=key)
+          {
+            layout.key=key;
+            layout.markup=latexToPango(key);
+            pango.setMarkup(layout.markup);
+            layout.width=pango.width();
+          }
+        colWidth=max(colWidth,layout.width);
+        if (y+rowHeight>visibleTop && y<visibleBottom)
+          {
+            pango.setMarkup(layout.markup);
+            cairo_move_to(surface->cairo(),x,y);
+            pango.show();
+          }
         y+=rowHeight;
       }
 
@@ -306,6 +360,12 @@ namespace minsky
       {
         // horizontal lines
         if (row>0 && row<scrollRowStart) continue;
+        if (y>visibleBottom) break;
+        if (y<visibleTop)
+          {
+            y+=rowHeight;
+            continue;
+          }
         cairo_move_to(surface->cairo(),leftTableOffset,y);
         cairo_line_to(surface->cairo(),x,y);
         cairo_set_line_width(surface->cairo(),0.5);
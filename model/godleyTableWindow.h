@@ -25,6 +25,7 @@
 #define GODLEYTABLEWINDOW_H
 #include "godleyIcon.h"
 #include <cairoSurfaceImage.h>
+#include <map>
 #include <memory>
 #include <vector>
 
@@ -183,6 +184,22 @@ namespace minsky
     int rowY(double y) const;
     int motionRow=-1, motionCol=-1; ///< current cell under mouse motion
     std::deque<GodleyTable::Data> history;
+    /// rendering of a cell's text, reused whilst the cell's contents
+    /// and display options are unchanged
+    struct CellLayout
+    {
+      std::string key; ///< cell contents and display options rendered
+      std::string markup;
+      double width=0;
+      bool negative=false; ///< rendered in red
+    };
+    /// cell layouts by (row, col)
+    classdesc::Exclude<std::map<std::pair<unsigned,unsigned>,CellLayout>> cellLayouts;
+    /// row sum layouts by row
+    classdesc::Exclude<std::map<unsigned,CellLayout>> rowSumLayouts;
+    double cellLayoutZoom=0; ///< zoomFactor cellLayouts was computed at
+    /// table dimensions cellLayouts was computed for
+    size_t cellLayoutRows=0, cellLayoutCols=0;
     ClickType clickType(double x, double y) const;
     void checkCell00(); ///<check is cell (0,0) is selected, and deselect if so
     /// handle delete or backspace. Cell assumed selected
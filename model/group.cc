@@ -111,6 +111,7 @@ namespace minsky
         {
           ItemPtr r=*i;
           items.erase(i);
+          spatialIndex.remove(*r);
           if (auto v=r->variableCast())
               if (v->ioVar())
                 {
@@ -145,6 +146,7 @@ namespace minsky
         {
           WirePtr r=*i;
           wires.erase(i);
+          spatialIndex.invalidateWires();
           return r;
         }
 
@@ -270,6 +272,7 @@ namespace minsky
             intOp->intVar->controller.reset();
         }
     items.push_back(it);
+    spatialIndex.insert(it);
     return items.back();
   }
 
@@ -365,6 +368,12 @@ namespace minsky
     return count;
   }
 
+  void GroupItems::invalidateSpatialIndices() const
+  {
+    spatialIndex.invalidate();
+    for (auto& i: groups) i->invalidateSpatialIndices();
+  }
+
 
   void Group::moveContents(Group& source) {
      if (&source!=this)
@@ -484,6 +493,7 @@ namespace minsky
     double sx=(fabs(b.x0-b.x1)-z*(l+r))/(x1-x0), sy=fabs(b.y0-b.y1)/(y1=y0);
     resizeItems(items,sx,sy);
     resizeItems(groups,sx,sy);
+    spatialIndex.invalidate();
     moveTo(0.5*(b.x0+b.x1), 0.5*(b.y0+b.y1));
     bb.update(*this);
   }
@@ -515,6 +525,7 @@ namespace minsky
   {
     assert(w->from() && w->to());
     wires.push_back(w);
+    spatialIndex.invalidateWires();
     return wires.back();
   }
   WirePtr GroupItems::addWire
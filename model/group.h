@@ -28,6 +28,7 @@
 #include "variable.h"
 #include <function.h>
 #include "SVGItem.h"
+#include "spatialIndex.h"
 
 namespace minsky
 {
@@ -46,6 +47,8 @@ namespace minsky
     GroupItems(const GroupItems& x) {};
     GroupItems& operator=(const GroupItems&) {return *this;}
     std::weak_ptr<Group> self; ///< weak ref to this
+    /// index of items and wires for hit testing on the canvas
+    mutable classdesc::Exclude<SpatialIndex> spatialIndex;
     
     void clear() {
       items.clear();
@@ -53,8 +56,12 @@ namespace minsky
       wires.clear();
       inVariables.clear();
       outVariables.clear();
+      spatialIndex.invalidate();
     }
     bool empty() const {return items.empty() && groups.empty() && wires.empty();}
+    /// discard the spatial indices of this and all contained groups,
+    /// for when items have been positioned directly
+    void invalidateSpatialIndices() const;
 
 
     /// plot widget used for group icon
@@ -35,6 +35,20 @@ using namespace std;
 
 namespace minsky
 {
+  namespace
+  {
+    /// inform spatial indices of a change in \a x's position or extent
+    void updateSpatialIndex(const Item& x)
+    {
+      if (auto g=x.group.lock())
+        {
+          g->spatialIndex.update(x);
+          // wires attached to x may be indexed by any enclosing group
+          for (; g; g=g->group.lock())
+            g->spatialIndex.invalidateWires();
+        }
+    }
+  }
 
   void BoundingBox::update(const Item& x)
   {
@@ -53,10 +67,14 @@ namespace minsky
                                         &l,&t,&w,&h);
     // note (0,0) is relative to the (x,y) of icon.
     double invZ=1/x.zoomFactor();
+    BoundingBox prev=*this;
+    ++m_updates;
     left=l*invZ;
     right=(l+w)*invZ;
     top=t*invZ;
     bottom=(t+h)*invZ;
+    if (left!=prev.left || right!=prev.right || top!=prev.top || bottom!=prev.bottom)
+      updateSpatialIndex(x);
   }
 
   void Item::throw_error(const std::string& msg) const
@@ -104,6 +122,7 @@ namespace minsky
 
   void Item::moveTo(float x, float y)
   {
+    float prevX=m_x, prevY=m_y;
     if (auto g=group.lock())
       {
         float invZ=1/zoomFactor();
@@ -115,6 +134,8 @@ namespace minsky
         m_x=x;
         m_y=y;
       }
+    if (m_x!=prevX || m_y!=prevY)
+      updateSpatialIndex(*this);
     assert(abs(x-this->x())<1 && abs(y-this->y())<1);
   }
 
@@ -228,6 +249,14 @@ namespace minsky
     if (selected) drawSelected(cairo);
   }
 
+  void Item::drawSimplified(cairo_t* cairo) const
+  {
+    float z=zoomFactor(), w=z*width(), h=z*height();
+    cairo_rectangle(cairo,-0.5*w,-0.5*h,w,h);
+    for (auto& p: ports)
+      p->moveTo(x(),y());
+  }
+
   void Item::dummyDraw() const
   {
     ecolab::cairo::Surface s(cairo_recording_surface_create(CAIRO_CONTENT_COLOR_ALPHA,NULL));
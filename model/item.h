@@ -61,13 +61,22 @@ namespace minsky
   class BoundingBox
   {
     float left=0, right=0, top, bottom;
+    unsigned m_updates=0;
   public:
     void update(const Item& x);
+    /// number of calls to update(), as made after changes to the
+    /// item's content
+    unsigned updates() const {return m_updates;}
     bool contains(float x, float y) const {
       // extend each item by a portradius to solve ticket #903
       return left-portRadius<=x && right+portRadius>=x && bottom+portRadius>=y && top-portRadius<=y;
     }
     bool valid() const {return left!=right;}
+    /// region relative to the item's centre in which contains() is true
+    void extent(float& x0, float& y0, float& x1, float& y1) const {
+      x0=left-portRadius; x1=right+portRadius;
+      y0=top-portRadius; y1=bottom+portRadius;
+    }
     float width() const {return right-left;}
     float height() const {return bottom-top;}
   };
@@ -136,6 +145,23 @@ namespace minsky
 
     /// draw this item into a cairo context
     virtual void draw(cairo_t* cairo) const;
+    /// @{ Items whose appearance depends only on their own state,
+    /// apart from parts that change as a simulation runs, may have
+    /// drawIcon() cached by the canvas, and replayed until the model
+    /// is edited, or the item's zoom, rotation, focus or selection
+    /// changes. For these items, draw() must be equivalent to
+    /// drawIcon() followed by drawDynamic(). The positions of ports
+    /// relative to the item, as set by drawIcon(), are recorded with
+    /// the cached icon, and restored whenever it is replayed.
+    virtual bool iconCacheable() const {return false;}
+    virtual void drawIcon(cairo_t* cairo) const {draw(cairo);}
+    virtual void drawDynamic(cairo_t*) const {}
+    /// @}
+    /// adds a plain outline of the item to the current path, for
+    /// rendering items too small on screen for their details to be
+    /// discernible. Ports are collapsed onto the item's centre, so
+    /// that attached wires meet the outline.
+    virtual void drawSimplified(cairo_t* cairo) const;
     /// draw into a dummy cairo context, for purposes of calculating
     /// port positions
     void dummyDraw() const;
@@ -20,6 +20,11 @@
 #include "classdesc_access.h"
 #include "minsky.h"
 #include "flowCoef.h"
+#include "tripleBuffer.h"
+#include "simulationLog.h"
+#include "rosenbrock.h"
+#include "sparseJacobian.h"
+#include "nativeIntegrator.h"
 
 #include "TCL_obj_stl.h"
 #include <gsl/gsl_errno.h>
@@ -31,10 +36,13 @@
 #include <cairo/cairo-ps.h>
 #include <cairo/cairo-pdf.h>
 #include <cairo/cairo-svg.h>
+#include <zlib.h>
 
 //#include <thread>
 // std::thread apparently not supported on MXE for now...
 #include <boost/thread.hpp>
+#include <atomic>
+#include <unordered_map>
 using namespace std;
 
 using namespace minsky;
@@ -45,6 +53,25 @@ namespace
 {
   const char* schemaURL="http://minsky.sf.net/minsky";
 
+  /// next output time after \a time, given an output schedule of
+  /// either explicit \a times, or \a interval from \a t0
+  /// @return NaN if the schedule is exhausted, or empty
+  double nextScheduledTime(double time, double t0, double interval, const vector<double>& times)
+  {
+    // allow for rounding in times previously computed here
+    double eps=1e-10*max(1.0, fabs(time));
+    if (!times.empty())
+      {
+        auto i=upper_bound(times.begin(), times.end(), time+eps);
+        return i==times.end()? nan(""): *i;
+      }
+    if (interval>0)
+      // computed from t0, rather than accumulated, so output times
+      // are reproducible
+      return t0+interval*(floor((time+eps-t0)/interval)+1);
+    return nan("");
+  }
+
   inline bool isFinite(const double y[], size_t n)
   {
     for (size_t i=0; i<n; ++i)
@@ -86,15 +113,99 @@ namespace
      }   
     return GSL_SUCCESS;
   }
+
+  /*
+    Binary save file format: magic string, format version, size of
+    the packed schema, followed by the zlib compressed pack_t
+    serialisation of schema2::Minsky.
+  */
+  const char binaryMagic[]="MinskyBin";
+  const uint32_t binaryFormatVersion=1;
+
+  void writeXML(const string& filename, schema2::Minsky& m)
+  {
+    ofstream of(filename);
+    xml_pack_t saveFile(of, schemaURL);
+    saveFile.prettyPrint=true;
+    try
+      {
+        xml_pack(saveFile, "Minsky", m);
+      }
+    catch (...) {
+      // if exception is due to file error, provide a more useful message
+      if (!of)
+        throw runtime_error("cannot save to "+filename);
+      throw;
+    }
+  }
+
+  void writeBinary(const string& filename, schema2::Minsky& m)
+  {
+    pack_t buf;
+    buf<<m;
+    // favour speed over compression ratio, as this is used for autosaving
+    uLongf zsize=compressBound(buf.size());
+    vector<Bytef> zbuf(zsize);
+    if (compress2(zbuf.data(), &zsize, (const Bytef*)buf.data(), buf.size(),
+                  Z_BEST_SPEED)!=Z_OK)
+      throw runtime_error("compression failure saving "+filename);
+    uint64_t size=buf.size();
+    ofstream of(filename, ios::binary);
+    of.write(binaryMagic, sizeof(binaryMagic));
+    of.write((const char*)&binaryFormatVersion, sizeof(binaryFormatVersion));
+    of.write((const char*)&size, sizeof(size));
+    of.write((const char*)zbuf.data(), zsize);
+    if (!of)
+      throw runtime_error("cannot save to "+filename);
+  }
+
+  /// return true if \a is contains a binary save file. Resets
+  /// stream to the beginning
+  bool isBinarySave(istream& is)
+  {
+    char magic[sizeof(binaryMagic)]{};
+    is.read(magic, sizeof(magic));
+    bool r=is && memcmp(magic, binaryMagic, sizeof(magic))==0;
+    is.clear();
+    is.seekg(0);
+    return r;
+  }
+
+  void readBinary(istream& is, schema2::Minsky& m)
+  {
+    char magic[sizeof(binaryMagic)];
+    uint32_t version=0;
+    uint64_t size=0;
+    is.read(magic, sizeof(magic));
+    is.read((char*)&version, sizeof(version));
+    is.read((char*)&size, sizeof(size));
+    if (!is || version<1 || version>binaryFormatVersion)
+      throw error("unsupported binary Minsky file version %d", version);
+    vector<Bytef> zbuf((istreambuf_iterator<char>(is)), istreambuf_iterator<char>());
+    // deflate cannot compress better than 1032:1, so check the header
+    // before allocating the buffer
+    if (size/1032>zbuf.size())
+      throw error("corrupt binary Minsky file");
+    pack_t buf(size);
+    uLongf unzippedSize=size;
+    if (uncompress((Bytef*)buf.data(), &unzippedSize, zbuf.data(), zbuf.size())!=Z_OK ||
+        unzippedSize!=size)
+      throw error("corrupt binary Minsky file");
+    buf>>m;
+  }
 }
 
 namespace minsky
 {
+  thread_local string MinskyExclude::threadErrMsg;
+  thread_local const MinskyExclude::EvalContext* MinskyExclude::evalContext=nullptr;
 
   struct RKdata
   {
     gsl_odeiv2_system sys;
-    gsl_odeiv2_driver* driver;
+    gsl_odeiv2_driver* driver=nullptr;
+    /// built in integrator, used in place of driver if set
+    shared_ptr<NativeIntegrator> native;
 
     static void errHandler(const char* reason, const char* file, int line, int gsl_errno) {
       throw error("gsl: %s:%d: %s",file,line,reason);
@@ -106,6 +217,11 @@ namespace minsky
       sys.jacobian=jacobian;
       sys.dimension=ValueVector::stockVars.size();
       sys.params=minsky;
+      if (!minsky->implicit && minsky->integrator!=RungeKutta::gslIntegrator)
+        {
+          native=make_shared<NativeIntegrator>(*minsky, minsky->integrator, sys.dimension);
+          return;
+        }
       const gsl_odeiv2_step_type* stepper;
       switch (minsky->order)
         {
@@ -114,8 +230,10 @@ namespace minsky
             throw error("First order explicit solver not available");
           stepper=gsl_odeiv2_step_rk1imp;
           break;
-        case 2: 
-          stepper=minsky->implicit? gsl_odeiv2_step_rk2imp: gsl_odeiv2_step_rk2;
+        case 2:
+          // sparse Rosenbrock scales to large stiff systems, where
+          // rk2imp's dense Jacobian does not
+          stepper=minsky->implicit? step_ros2sparse: gsl_odeiv2_step_rk2;
           break;
         case 4:
           stepper=minsky->implicit? gsl_odeiv2_step_rk4imp: gsl_odeiv2_step_rkf45;
@@ -129,7 +247,462 @@ namespace minsky
       gsl_odeiv2_driver_set_hmax(driver, minsky->stepMax);
       gsl_odeiv2_driver_set_hmin(driver, minsky->stepMin);
     }
-    ~RKdata() {gsl_odeiv2_driver_free(driver);}
+    ~RKdata() {if (driver) gsl_odeiv2_driver_free(driver);}
+
+    /// advance \a t and \a y by up to \a nSteps steps
+    /// @return GSL error code
+    int apply(double& t, double y[], int nSteps) {
+      if (native || !static_cast<Minsky*>(sys.params)->discontinuities.empty())
+        {
+          for (int i=0; i<nSteps; ++i)
+            if (int err=step(t, y))
+              return err;
+          return GSL_SUCCESS;
+        }
+      gsl_odeiv2_driver_set_nmax(driver, nSteps);
+      return gsl_odeiv2_driver_apply(driver, &t, numeric_limits<double>::max(), y);
+    }
+
+    /// take a single step of the solver's choosing, not going beyond \a tMax
+    /// @param checkMin whether to fail if the step size falls below hmin
+    int rawStep(double& t, double y[], double tMax, bool checkMin=true) {
+      if (native)
+        return native->step(t, y, tMax);
+      int err=gsl_odeiv2_evolve_apply(driver->e, driver->c, driver->s, driver->sys,
+                                      &t, tMax, &driver->h, y);
+      if (err!=GSL_SUCCESS) return err;
+      // step size limits, as applied by gsl_odeiv2_driver_apply
+      if (fabs(driver->h)>driver->hmax)
+        driver->h=copysign(driver->hmax, driver->h);
+      if (checkMin && fabs(driver->h)<driver->hmin)
+        return GSL_ENOPROG;
+      return GSL_SUCCESS;
+    }
+
+    /// cubic Hermite interpolation between (t0,y0) and (t1,y1), with
+    /// derivatives f0 and f1
+    static void hermite(vector<double>& y, double t, double t0, const vector<double>& y0,
+                        const vector<double>& f0, double t1, const vector<double>& y1,
+                        const vector<double>& f1) {
+      double h=t1-t0, th=(t-t0)/h, th2=th*th, th3=th2*th;
+      double h00=2*th3-3*th2+1, h10=th3-2*th2+th, h01=3*th2-2*th3, h11=th3-th2;
+      y.resize(y0.size());
+      for (size_t i=0; i<y.size(); ++i)
+        y[i]=h00*y0[i]+h*(h10*f0[i]+h11*f1[i])+h01*y1[i];
+    }
+
+    /// @{ workspace for event location
+    vector<double> branch0, branch1, yLo, fLo, yHi, fHi, yMid;
+    /// @}
+
+    /// take a single step of the solver's choosing. If a piecewise
+    /// operation changes branch during the step, the step is cut
+    /// short just past the earliest such event, and the solver is
+    /// restarted there, so that no step straddles a discontinuity.
+    int step(double& t, double y[]) {
+      auto& minsky=*static_cast<Minsky*>(sys.params);
+      if (minsky.discontinuities.empty())
+        return rawStep(t, y, numeric_limits<double>::max());
+
+      double tStart=t, hStart=stepSize();
+      yLo.assign(y, y+sys.dimension);
+      minsky.evalBranches(branch0, t, y);
+      if (int err=rawStep(t, y, numeric_limits<double>::max()))
+        return err;
+      minsky.evalBranches(branch1, t, y);
+      if (branch0==branch1)
+        return GSL_SUCCESS;
+
+      // The earliest change of branch is bracketed by tLo, where the
+      // branches are those at the start of the step, and tHi, where
+      // they differ. Locate it by bisecting the cubic Hermite
+      // interpolant over the bracket, then integrate from tLo to just
+      // past it, narrowing the bracket, until the interpolant places
+      // the event at tHi. Solutions up to the event are computed over
+      // a smooth right hand side, so are accurate.
+      const int maxIterations=16;
+      double tLo=tStart, tHi=t, tol=1e-10*(t-tStart);
+      yHi.assign(y, y+sys.dimension);
+      fLo.resize(sys.dimension);
+      fHi.resize(sys.dimension);
+      minsky.evalEquations(&fLo[0], tLo, &yLo[0]);
+      minsky.evalEquations(&fHi[0], tHi, &yHi[0]);
+      for (int i=0; i<maxIterations && tHi-tLo>tol; ++i)
+        {
+          double lo=tLo, hi=tHi;
+          while (hi-lo>tol)
+            {
+              double mid=0.5*(lo+hi);
+              if (mid<=lo || mid>=hi) break;
+              hermite(yMid, mid, tLo, yLo, fLo, tHi, yHi, fHi);
+              minsky.evalBranches(branch1, mid, &yMid[0]);
+              (branch1==branch0? lo: hi)=mid;
+            }
+          if (tHi-hi<=tol)
+            break;
+
+          t=tLo;
+          copy(yLo.begin(), yLo.end(), y);
+          setStepSize(hi-tLo);
+          while (t<hi)
+            if (int err=rawStep(t, y, hi, false))
+              return err;
+          minsky.evalBranches(branch1, t, y);
+          if (branch1==branch0)
+            {
+              tLo=t;
+              yLo.assign(y, y+sys.dimension);
+              minsky.evalEquations(&fLo[0], t, y);
+            }
+          else
+            {
+              tHi=t;
+              yHi.assign(y, y+sys.dimension);
+              minsky.evalEquations(&fHi[0], t, y);
+            }
+        }
+
+      // finish just past the event, and restart the solver from there
+      t=tHi;
+      copy(yHi.begin(), yHi.end(), y);
+      setStepSize(hStart);
+      return GSL_SUCCESS;
+    }
+
+    /// discard any information retained from previous steps
+    void resetSolver() {
+      if (native)
+        native->reset();
+      else
+        gsl_odeiv2_driver_reset(driver);
+      denseValid=false;
+    }
+
+    double stepSize() const {return native? native->h: driver->h;}
+    void setStepSize(double h) {
+      if (native)
+        {
+          native->reset();
+          native->h=h;
+        }
+      else
+        gsl_odeiv2_driver_reset_hstart(driver, h);
+    }
+
+    /// @{ most recent step accepted by the solver, from t0 to t1, and
+    /// the derivatives at either end, if computed
+    double t0=0, t1=0;
+    vector<double> y0, y1, f0, f1;
+    bool haveF0=false, haveF1=false;
+    /// @}
+    /// last interpolated state returned by advanceTo
+    double tLast=0;
+    vector<double> yLast;
+    bool denseValid=false;
+
+    /// advance the solution \a t, \a y to time \a tOut, letting the
+    /// solver choose its own step sizes, and obtaining y(tOut) by
+    /// cubic Hermite interpolation within the step containing tOut. The
+    /// solver's state is retained between calls, so consecutive
+    /// outputs falling within the same step cost no further steps.
+    /// @return GSL error code
+    int advanceTo(double& t, vector<double>& y, double tOut) {
+      auto& minsky=*static_cast<Minsky*>(sys.params);
+      if (!denseValid || t!=tLast || y!=yLast)
+        {
+          // state has been changed externally, restart from it
+          t0=t1=t;
+          y0=y1=y;
+          haveF0=haveF1=false;
+          if (native)
+            native->reset();
+          else
+            gsl_odeiv2_evolve_reset(driver->e);
+          denseValid=true;
+        }
+      while (t1<tOut)
+        {
+          t0=t1;
+          y0=y1;
+          f0.swap(f1);
+          haveF0=haveF1;
+          haveF1=false;
+          if (int err=step(t1, &y1[0]))
+            {
+              denseValid=false;
+              return err;
+            }
+          if (native && native->fsal())
+            {
+              f1.assign(native->fsal(), native->fsal()+y1.size());
+              haveF1=true;
+            }
+        }
+      if (tOut==t1)
+        y=y1;
+      else
+        {
+          if (!haveF0)
+            {
+              f0.resize(y.size());
+              minsky.evalEquations(&f0[0], t0, &y0[0]);
+              haveF0=true;
+            }
+          if (!haveF1)
+            {
+              f1.resize(y.size());
+              minsky.evalEquations(&f1[0], t1, &y1[0]);
+              haveF1=true;
+            }
+          hermite(y, tOut, t0, y0, f0, t1, y1, f1);
+        }
+      tLast=t=tOut;
+      yLast=y;
+      return GSL_SUCCESS;
+    }
+  };
+
+  /// save running on a worker thread
+  struct BackgroundSave
+  {
+    std::string errMsg;
+    std::atomic<bool> running{true};
+    /// Minsky::editCount at the time the snapshot was taken
+    unsigned long editCount;
+    boost::thread thread;
+    template <class F>
+    BackgroundSave(F f, unsigned long editCount): editCount(editCount), thread([this,f]() {
+        try
+          {
+            f();
+          }
+        catch (const std::exception& ex)
+          {
+            errMsg=ex.what();
+          }
+        catch (...)
+          {
+            errMsg="Unknown exception thrown on save thread";
+          }
+        running=false;
+      }) {}
+    ~BackgroundSave() {if (thread.joinable()) thread.join();}
+  };
+
+  /// persistent worker thread on which the ODE solver is run
+  struct SimulationThread
+  {
+    /// simulation state published by the worker thread
+    struct State
+    {
+      double t=0;
+      vector<double> stockVars, flowVars;
+      int err=GSL_SUCCESS;
+      string errMsg;
+    };
+    TripleBuffer<State> results;
+
+    /// Minsky's settings that the worker integrates with. These are
+    /// copied under mutex whenever work is handed to the worker, as
+    /// the GUI thread may change Minsky's whilst the worker runs.
+    struct Settings
+    {
+      int nSteps=1;
+      bool reverse=false;
+      double stepMax=0, t0=0, outputInterval=0;
+      vector<double> outputTimes;
+      Settings() {}
+      explicit Settings(const Minsky& m):
+        nSteps(m.nSteps), reverse(m.reverse), stepMax(m.stepMax), t0(m.t0),
+        outputInterval(m.outputInterval), outputTimes(m.outputTimes) {}
+      bool outputScheduled() const {return outputInterval>0 || !outputTimes.empty();}
+      double nextOutputTime(double time) const
+      {return nextScheduledTime(time, t0, outputInterval, outputTimes);}
+    };
+
+    Minsky& minsky;
+    /// private copy of simulation state for use by the worker, so
+    /// that the GUI thread can update Minsky's state whilst it runs
+    double t=0;
+    vector<double> stockVars, flowVars;
+    /// set when the GUI thread may have changed Minsky's state, which
+    /// then needs to be copied into the private state. Only accessed
+    /// on the GUI thread.
+    bool stateChanged=true;
+    
+    /// @{ shared between the threads, protected by mutex
+    boost::mutex mutex;
+    boost::condition_variable cond;
+    Settings settings;
+    /// number of batches of nSteps requested
+    int requested=0;
+    bool continuous=false, busy=false, shutdown=false;
+    /// when running continuously, the worker carries on until this
+    /// time, which step() extends on each call, so that the worker
+    /// comes to a halt once the GUI stops running the simulation
+    ptime leaseExpiry;
+    /// @}
+    const int leaseMS=1000;
+    boost::thread thread;
+
+    SimulationThread(Minsky& minsky): minsky(minsky), thread([this]() {run();}) {}
+    ~SimulationThread() {
+      {
+        boost::lock_guard<boost::mutex> lock(mutex);
+        shutdown=true;
+        cond.notify_all();
+      }
+      thread.join();
+    }
+
+    /// whether to carry on integrating without a request. Call with
+    /// mutex held.
+    bool leased() const
+    {return continuous && microsec_clock::universal_time()<leaseExpiry;}
+
+    void run() {
+      boost::unique_lock<boost::mutex> lock(mutex);
+      for (;;)
+        {
+          while (!shutdown && requested==0 && !leased())
+            cond.wait(lock);
+          if (shutdown) return;
+          if (requested>0) --requested;
+          busy=true;
+          Settings s=settings;
+          lock.unlock();
+          bool ok=integrate(s);
+          lock.lock();
+          busy=false;
+          if (!ok) continuous=false;
+          cond.notify_all();
+        }
+    }
+
+    /// advance private state by nSteps, or to the next scheduled
+    /// output time, and publish the result
+    /// @return false if an error occurred, or the output schedule is exhausted
+    bool integrate(const Settings& s) {
+      auto& r=results.back();
+      r.err=GSL_SUCCESS;
+      r.errMsg.clear();
+      bool exhausted=false;
+      minsky.RKThreadRunning=true;
+      MinskyExclude::EvalContext context{&flowVars, s.reverse};
+      MinskyExclude::evalContext=&context;
+      try
+        {
+          double tp=s.reverse? -t: t;
+          if (minsky.ode && !s.reverse && s.outputScheduled())
+            {
+              double tOut=s.nextOutputTime(t);
+              if (std::isnan(tOut))
+                exhausted=true; // end of the output schedule
+              else
+                r.err=minsky.ode->advanceTo(tp, stockVars, tOut);
+            }
+          else if (minsky.ode)
+            {
+              r.err=minsky.ode->apply(tp, &stockVars[0], s.nSteps);
+            }
+          else // do explicit Euler method
+            {
+              vector<double> d(stockVars.size());
+              for (int i=0; i<s.nSteps; ++i, tp+=s.stepMax)
+                {
+                  minsky.evalEquations(&d[0], tp, &stockVars[0]);
+                  for (size_t j=0; j<d.size(); ++j)
+                    stockVars[j]+=d[j];
+                }
+            }
+          t=s.reverse? -tp:tp;
+          // compute flow variables corresponding to the new stocks
+          r.flowVars=flowVars;
+          EvalOpBase::t=t;
+          for (auto& eq: minsky.equations)
+            eq->eval(&r.flowVars[0], &stockVars[0]);
+        }
+      catch (const std::exception& ex)
+        {
+          // catch any thrown exception, and report back to GUI thread
+          r.errMsg=ex.what();
+        }
+      catch (...)
+        {
+          r.errMsg="Unknown exception thrown on ODE solver thread";
+        }
+      if (!MinskyExclude::threadErrMsg.empty())
+        {
+          r.errMsg=MinskyExclude::threadErrMsg;
+          MinskyExclude::threadErrMsg.clear();
+        }
+      MinskyExclude::evalContext=nullptr;
+      minsky.RKThreadRunning=false;
+      r.t=t;
+      r.stockVars=stockVars;
+      results.publish();
+      return !exhausted && r.errMsg.empty() && (r.err==GSL_SUCCESS || r.err==GSL_EMAXITER);
+    }
+
+    /// wait for the worker to complete any requested steps and become idle
+    void waitUntilIdle() {
+      boost::unique_lock<boost::mutex> lock(mutex);
+      continuous=false;
+      while (busy || requested>0) cond.wait(lock);
+    }
+
+    /// stop the worker, so that the GUI thread can change the
+    /// simulation state
+    void pause() {
+      waitUntilIdle();
+      stateChanged=true;
+    }
+
+    /// start the worker integrating from its private state, picking
+    /// up the model's state if that may have changed since
+    /// @param cont run continuously rather than a single batch of steps
+    void start(bool cont) {
+      waitUntilIdle();
+      results.consume(); // discard any stale results
+      boost::lock_guard<boost::mutex> lock(mutex);
+      if (stateChanged)
+        {
+          t=minsky.t;
+          stockVars=ValueVector::stockVars;
+          flowVars=ValueVector::flowVars;
+          stateChanged=false;
+        }
+      settings=Settings(minsky);
+      continuous=cont;
+      if (cont)
+        leaseExpiry=microsec_clock::universal_time()+milliseconds(leaseMS);
+      else
+        requested=1;
+      cond.notify_all();
+    }
+
+    /// keep a continuously running worker going, with Minsky's
+    /// current settings
+    void renew() {
+      boost::lock_guard<boost::mutex> lock(mutex);
+      settings=Settings(minsky);
+      leaseExpiry=microsec_clock::universal_time()+milliseconds(leaseMS);
+      cond.notify_all();
+    }
+
+    bool running() {
+      boost::lock_guard<boost::mutex> lock(mutex);
+      return busy || requested>0 || leased();
+    }
+    
+    /// wait up to \a ms milliseconds for a result to be published
+    /// @return true if a new result is available at results.front()
+    bool waitForResult(int ms) {
+      boost::unique_lock<boost::mutex> lock(mutex);
+      if (!results.ready())
+        cond.timed_wait(lock, boost::posix_time::milliseconds(ms));
+      return results.consume();
+    }
   };
 
   struct BusyCursor
@@ -150,35 +723,92 @@ using namespace std;
 
 namespace minsky
 {
+  void EquationDisplay::redraw(int, int, int, int)
+  {
+    if (!surface.get()) return;
+    if (!cachedEquations.get() || m.canvas.model.timestamp>lastRender)
+      {
+        auto renderTime=Canvas::Timestamp::clock::now();
+        MathDAG::SystemOfEquations system(m);
+        cairo::SurfacePtr equations
+          (new cairo::Surface(cairo_recording_surface_create(CAIRO_CONTENT_COLOR_ALPHA,NULL)));
+        system.renderEquations(*equations);
+        cachedEquations.swap(equations);
+        lastRender=renderTime;
+        m_width=cachedEquations->width();
+        m_height=cachedEquations->height();
+      }
+    cairo_set_source_surface(surface->cairo(), cachedEquations->surface(), offsx, offsy);
+    cairo_paint(surface->cairo());
+  }
+
+  namespace
+  {
+    /// locate the values of \a valueIds. Values no longer allocated
+    /// are logged as NaN.
+    vector<SimulationLog::Slot> logSlots(const VariableValues& values,
+                                         const vector<string>& valueIds)
+    {
+      vector<SimulationLog::Slot> slots;
+      for (auto& i: valueIds)
+        {
+          auto v=values.find(i);
+          if (v==values.end() || v->second.idx()<0)
+            slots.push_back({&ValueVector::flowVars, ~size_t(0)});
+          else
+            slots.push_back({v->second.isFlowVar()? &ValueVector::flowVars: &ValueVector::stockVars,
+                  size_t(v->second.idx())});
+        }
+      return slots;
+    }
+  }
+  
   void Minsky::openLogFile(const string& name)
   {
-    outputDataFile.reset(new ofstream(name));
-    *outputDataFile<< "#time";
+    outputDataFile.reset(); // flush any previous log first
+    // resolve the logged variables to their locations once, rather
+    // than on each step. They are resolved again by reset().
+    vector<string> names;
+    loggedValueIds.clear();
     for (auto& v: variableValues)
       if (logVarList.count(v.first))
-        *outputDataFile<<" "<<v.second.name;
-    *outputDataFile<<endl;
+        {
+          names.push_back(v.second.name);
+          loggedValueIds.push_back(v.first);
+        }
+    outputDataFile.reset
+      (new SimulationLog(name, names, logSlots(variableValues, loggedValueIds),
+                         SimulationLog::formatFor(name)));
+  }
+
+  void Minsky::closeLogFile()
+  {
+    shared_ptr<SimulationLog> log;
+    log.swap(outputDataFile);
+    if (log) log->flush();
   }
 
   /// write current state of all variables to the log file
   void Minsky::logVariables() const
   {
     if (outputDataFile)
-      {
-        *outputDataFile<<t;
-        for (auto& v: variableValues)
-          if (logVarList.count(v.first))
-            *outputDataFile<<" "<<v.second.value();
-        *outputDataFile<<endl;
-      }
+      outputDataFile->append(t);
   }        
         
       
 
+  Minsky::~Minsky()
+  {
+    // worker must be stopped before the data it uses is destroyed
+    simulationThread.reset();
+  }
+  
   void Minsky::clearAllMaps()
   {
+    pauseSimulationThread();
     model->clear();
     equations.clear();
+    discontinuities.clear();
     integrals.clear();
     variableValues.clear();
     
@@ -230,11 +860,15 @@ namespace minsky
 
   void Minsky::copy() const
   {
-    schema2::Minsky m(canvas.selection);
+    auto m=make_shared<schema2::Minsky>(canvas.selection);
     ostringstream os;
     xml_pack_t packer(os, schemaURL);
-    xml_pack(packer, "Minsky", m);
+    xml_pack(packer, "Minsky", *m);
     putClipboard(os.str());
+    // keep the schema object, so that pasting into this process can
+    // skip XML parsing
+    clipboardSchema=m;
+    clipboardText=os.str();
   }
 
   VariablePtr Minsky::definingVar(const string& valueId) const 
@@ -242,9 +876,8 @@ namespace minsky
     return dynamic_pointer_cast<VariableBase>
       (model->findAny(&Group::items, [&](const ItemPtr& x) {
             auto v=x->variableCast();
-            return v && v->valueId()==valueId &&
-              ((v->ports.size()>1 && !v->ports[1]->wires().empty()) ||
-               (v->type()==VariableValue::stock && v->controller.lock())) ;
+            // test the cheap condition first, as valueId() resolves scope
+            return v && v->definesValue() && v->valueId()==valueId;
           }));
   }
     
@@ -258,16 +891,36 @@ namespace minsky
 //      throw runtime_error("cannot save to "+fileName);
   }
 
+  namespace
+  {
+    void addAsGroup(Minsky& minsky, const schema2::Minsky& m)
+    {
+      GroupPtr g(new Group);
+      minsky.canvas.setItemFocus(minsky.model->addGroup(g));
+      m.populateGroup(*g);
+      g->resizeOnContents();
+    }
+  }
+  
   void Minsky::paste()
   {
-    istringstream is(getClipboard());
-    xml_unpack_t unpacker(is);
-    schema2::Minsky m;
-    xml_unpack(unpacker, "Minsky", m);
-    GroupPtr g(new Group);
-    canvas.setItemFocus(model->addGroup(g));
-    m.populateGroup(*g);
-    g->resizeOnContents();
+    auto clipboard=getClipboard();
+    if (clipboardSchema && clipboard==clipboardText)
+      // clipboard contents are unchanged since we copied them
+      addAsGroup(*this, *clipboardSchema);
+    else
+      {
+        schema2::Minsky m;
+        istringstream is(clipboard);
+        xml_unpack_t unpacker(is);
+        xml_unpack(unpacker, "Minsky", m);
+        addAsGroup(*this, m);
+      }
+  }
+
+  void Minsky::duplicateSelection()
+  {
+    addAsGroup(*this, schema2::Minsky(canvas.selection));
   }
 
   void Minsky::toggleSelected(ItemType itemType, int item)
@@ -333,6 +986,7 @@ namespace minsky
 
   void Minsky::garbageCollect()
   {
+    pauseSimulationThread();
     makeVariablesConsistent();
     stockVars.clear();
     flowVars.clear();
@@ -366,6 +1020,22 @@ namespace minsky
     equations.clear();
     integrals.clear();
 
+    // decode tensor data deferred at load time only for values wired
+    // into the model, which includes the inputs of Sheets and Ravels
+    model->recursiveDo
+      (&Group::items,
+       [&](Items&, Items::iterator i)
+       {
+         if (auto v=(*i)->variableCast())
+           if (!v->ports.empty() && !v->ports[0]->wires().empty())
+             {
+               auto vv=variableValues.find(v->valueId());
+               if (vv!=variableValues.end())
+                 vv->second.loadTensorInit();
+             }
+         return false;
+       });
+
     dimensionalAnalysis();
     
     EvalOpBase::timeUnit=timeUnit;
@@ -374,6 +1044,10 @@ namespace minsky
     assert(variableValues.validEntries());
     system.populateEvalOpVector(equations, integrals);
     assert(variableValues.validEntries());
+    discontinuities.clear();
+    for (auto& e: equations)
+      if (e->piecewise())
+        discontinuities.push_back(e);
     
     // attach the plots
     model->recursiveDo
@@ -664,18 +1338,102 @@ namespace minsky
                                  GodleyIt(godleyItems.end()), variableValues);
   }
 
+  namespace
+  {
+    bool isParameter(const schema2::Item& i)
+    {return i.type=="Variable:parameter";}
+
+    /// serialise \a m into \a buf for the undo history, with
+    /// parameter values following the rest of the model
+    void packHistoryState(pack_t& buf, schema2::Minsky& m)
+    {
+      // move the parameter values out of m whilst it is packed
+      struct ParameterValue
+      {
+        decltype(schema2::Item::init) init;
+        decltype(schema2::Item::slider) slider;
+        decltype(schema2::Item::tensorData) tensorData;
+      };
+      vector<ParameterValue> values;
+      for (auto& i: m.items)
+        if (isParameter(i))
+          {
+            values.push_back({i.init, i.slider, i.tensorData});
+            i.init.reset();
+            i.slider.reset();
+            i.tensorData.reset();
+          }
+      buf<<m;
+      auto v=values.begin();
+      for (auto& i: m.items)
+        if (isParameter(i))
+          {
+            buf<<v->init<<v->slider<<v->tensorData;
+            i.init=v->init;
+            i.slider=v->slider;
+            i.tensorData=v->tensorData;
+            ++v;
+          }
+    }
+
+    /// serialise the structure of \a m into \a buf. Parameter values,
+    /// which are applied in place, and the layout of items and wires
+    /// do not bear on the equations, so are omitted.
+    void packStructure(pack_t& buf, schema2::Minsky m)
+    {
+      auto clearLayout=[](schema2::Item& i) {
+        i.x=i.y=0;
+        i.zoomFactor=1;
+        i.rotation=0;
+        i.width.reset();
+        i.height.reset();
+        i.iconScale.reset();
+        i.bookmarks.reset();
+      };
+      // Optional fields are shared with the original, so are reset
+      // rather than modified
+      for (auto& i: m.items)
+        {
+          clearLayout(i);
+          if (isParameter(i))
+            {
+              i.init.reset();
+              i.slider.reset();
+              i.tensorData.reset();
+            }
+        }
+      for (auto& g: m.groups)
+        clearLayout(g);
+      for (auto& w: m.wires)
+        w.coords.reset();
+      m.zoomFactor=1;
+      m.bookmarks.clear();
+      buf<<m;
+    }
+
+    void unpackHistoryState(pack_t& buf, schema2::Minsky& m)
+    {
+      buf>>m;
+      for (auto& i: m.items)
+        if (isParameter(i))
+          buf>>i.init>>i.slider>>i.tensorData;
+    }
+  }
+
   void Minsky::reset()
   {
-    // do not reset while simulation is running
-    if (RKThreadRunning)
+    // do not reset whilst step() is waiting on a result - it will
+    // reset once the result is received
+    if (awaitingStep)
       {
         flags |= reset_needed;
-        if (RKThreadRunning) return;
+        return;
       }
+    pauseSimulationThread();
     running=false;
     canvas.itemIndicator=false;
     BusyCursor busy(*this);
-    EvalOpBase::t=t=t0;
+    EvalOpBase::t=t=lastCheckpoint=t0;
     constructEquations();
     // if no stock variables in system, add a dummy stock variable to
     // make the simulation proceed
@@ -685,7 +1443,7 @@ namespace minsky
 
     if (stockVars.size()>0)
       {
-        if (order==1 && !implicit)
+        if (order==1 && !implicit && integrator==gslIntegrator)
           ode.reset(); // do explicit Euler
         else
           ode.reset(new RKdata(this)); // set up GSL ODE routines
@@ -711,71 +1469,152 @@ namespace minsky
              r->loadDataCubeFromVariable(r->ports[1]->getVariableValue());
          return false;
        });
+    // values may have been reallocated
+    if (outputDataFile)
+      outputDataFile->setSlots(logSlots(variableValues, loggedValueIds));
+    // taken from the model itself, as the history head is stale
+    // after an undo
+    pack_t structure;
+    packStructure(structure, schema2::Minsky(*this));
+    structureAtReset.assign((const char*)structure.data(),
+                            (const char*)structure.data()+structure.size());
+    parameterLayout(parameterLayoutAtReset);
+    parametersPending=false;
     canvas.requestRedraw();
   }
 
-  void Minsky::step()
+  void Minsky::parameterLayout(vector<char>& r) const
   {
-    if (reset_flag())
-      reset();
-    running=true;
-    
-    // create a private copy for worker thread use
-    vector<double> stockVarsCopy(stockVars);
-    RKThreadRunning=true;
-    int err=GSL_SUCCESS;
-    // run RK algorithm on a separate worker thread so as to no block UI. See ticket #6
-    boost::thread rkThread([&]() {
-      try
-        { 
-          double tp=reverse? -t: t;
-          if (ode)
-            {
-              gsl_odeiv2_driver_set_nmax(ode->driver, nSteps);
-              // we need to update Minsky's t synchronously to support the t operator
-              // potentially means t and stockVars out of sync on GUI, but should still be thread safe
-              err=gsl_odeiv2_driver_apply(ode->driver, &tp, numeric_limits<double>::max(), 
-                                          &stockVarsCopy[0]);
-            }
-          else // do explicit Euler method
+    pack_t buf;
+    for (auto& v: variableValues)
+      if (v.second.type()==VariableType::parameter)
+        buf<<v.first<<v.second.idx()<<v.second.numElements();
+    r.assign((const char*)buf.data(), (const char*)buf.data()+buf.size());
+  }
+
+  bool Minsky::structureChangedFrom(const char* structure, size_t size) const
+  {
+    if (reset_flag() || structureAtReset.empty() || size!=structureAtReset.size() ||
+        memcmp(structure, structureAtReset.data(), size)!=0)
+      return true;
+    // parameter values are written in place, so their layout must
+    // also be unchanged
+    vector<char> layout;
+    parameterLayout(layout);
+    return layout!=parameterLayoutAtReset;
+  }
+
+  bool Minsky::structureChanged() const
+  {
+    pack_t buf;
+    packStructure(buf, schema2::Minsky(*this));
+    return structureChangedFrom((const char*)buf.data(), buf.size());
+  }
+
+  bool Minsky::historyStructureChanged() const
+  {
+    if (!historySize()) return true;
+    return structureChangedFrom(historyStructure.data(), historyStructure.size());
+  }
+
+  void Minsky::markParametersEdited()
+  {
+    flags |= is_edited;
+    ++editCount;
+    canvas.model.updateTimestamp();
+    if (reset_flag()) return; // values will be picked up by reset()
+    if (awaitingStep)
+      {
+        // the result of the step in progress will overwrite
+        // flowVars, so apply the new values once it has completed
+        parametersPending=true;
+        return;
+      }
+    applyParameterValues();
+  }
+
+  void Minsky::applyParameterValues()
+  {
+    pauseSimulationThread();
+    for (auto& v: variableValues)
+      if (v.second.type()==VariableType::parameter && v.second.idx()>=0)
+        {
+          auto x=v.second.initValue(variableValues);
+          if (x.data.size()!=v.second.numElements())
             {
-              vector<double> d(stockVarsCopy.size());
-              for (int i=0; i<nSteps; ++i, tp+=stepMax)
-                {
-                  evalEquations(&d[0], tp, &stockVarsCopy[0]);
-                  for (size_t j=0; j<d.size(); ++j)
-                    stockVarsCopy[j]+=d[j];
-                }
+              markEdited();
+              return;
             }
-          t=reverse? -tp:tp;
-        }
-      catch (const std::exception& ex)
-        {
-          // catch any thrown exception, and report back to GUI thread
-          threadErrMsg=ex.what();
+          copy(x.data.begin(), x.data.end(), v.second.begin());
         }
-      catch (...)
-        {
-          threadErrMsg="Unknown exception thrown on ODE solver thread";
-        }
-      RKThreadRunning=false;
-    });
+    // step size history, and any stages or Jacobians retained by
+    // the solver, refer to the old parameter values
+    if (ode) ode->resetSolver();
+    EvalOpBase::t=t;
+    evalEquations();
+    canvas.requestRedraw();
+  }
+
+  double Minsky::nextOutputTime(double time) const
+  {return nextScheduledTime(time, t0, outputInterval, outputTimes);}
+
+  void Minsky::pauseSimulationThread()
+  {
+    if (simulationThread)
+      simulationThread->pause();
+  }
 
-    while (RKThreadRunning)
+  void Minsky::step()
+  {
+    if (reset_flag())
+      reset();
+    if (parametersPending && !awaitingStep)
+      {
+        parametersPending=false;
+        applyParameterValues();
+      }
+    // the schedule only applies where the worker follows it
+    if (ode && !reverse && outputScheduled() && std::isnan(nextOutputTime(t)))
       {
-        // while waiting for thread to finish, check and process any UI events
-        usleep(1000);
-        doOneEvent(false);
+        running=false; // reached end of the output schedule
+        return;
       }
-    rkThread.join();
+    running=true;
 
-    if (!threadErrMsg.empty())
+    // integration is performed on a separate worker thread so as not
+    // to block the UI. See ticket #6
+    if (!simulationThread)
+      simulationThread.reset(new SimulationThread(*this));
+    auto& sim=*simulationThread;
+    if (decoupledSimulation)
+      {
+        if (!sim.running())
+          sim.start(true);
+        else
+          sim.renew();
+        // pick up the most recent state, waiting no longer than a redraw interval
+        if (!sim.waitForResult(maxWaitMS))
+          return;
+      }
+    else
       {
-        runtime_error err(threadErrMsg);
-        threadErrMsg.clear();
-        // rethrow exception so message gets displayed to user
-        throw err;
+        sim.start(false);
+        awaitingStep=true;
+        // while waiting for the step to complete, process any UI
+        // events. The wait ends as soon as the result is published,
+        // so its timeout only bounds the latency of the UI.
+        while (!sim.waitForResult(uiLatencyMS))
+          doOneEvent(false);
+        awaitingStep=false;
       }
+    auto& result=sim.results.front();
+    // restart from Minsky's state, rather than the failed one
+    if (!result.errMsg.empty() || (result.err!=GSL_SUCCESS && result.err!=GSL_EMAXITER))
+      sim.stateChanged=true;
+
+    if (!result.errMsg.empty())
+      // rethrow exception so message gets displayed to user
+      throw runtime_error(result.errMsg);
     
     if (reset_flag()) // in case reset() was called during the step evaluation
       {
@@ -783,25 +1622,35 @@ namespace minsky
         return;
       }
 
-    switch (err)
+    switch (result.err)
       {
       case GSL_SUCCESS: case GSL_EMAXITER: break;
       case GSL_FAILURE:
         throw error("unspecified error GSL_FAILURE returned");
       case GSL_EBADFUNC: 
-        gsl_odeiv2_driver_reset(ode->driver);
+        ode->resetSolver();
         throw error("Invalid arithmetic operation detected");
       default:
-        throw error("gsl error: %s",gsl_strerror(err));
+        throw error("gsl error: %s",gsl_strerror(result.err));
       }
 
-    stockVars.swap(stockVarsCopy);
-
-    // update flow variables
-    evalEquations();
+    // publish the worker's state for display. The worker does not
+    // read these, so they can be updated whilst it runs decoupled.
+    t=result.t;
+    std::copy(result.stockVars.begin(), result.stockVars.end(), stockVars.begin());
+    std::copy(result.flowVars.begin(), result.flowVars.end(), flowVars.begin());
+    if (parametersPending)
+      {
+        parametersPending=false;
+        applyParameterValues();
+      }
 
     logVariables();
 
+    if (checkpointInterval>0 && !checkpointFile.empty() &&
+        fabs(t-lastCheckpoint)>=checkpointInterval)
+      saveCheckpoint(checkpointFile);
+
     model->recursiveDo
       (&Group::items, 
        [&](Items&, Items::iterator i) 
@@ -817,6 +1666,156 @@ namespace minsky
 
   }
 
+  void Minsky::runUntil(double tEnd)
+  {
+    if (reset_flag())
+      reset();
+    pauseSimulationThread();
+    if (reverse)
+      throw error("reverse simulation not supported in batch runs");
+    if (tEnd<t)
+      throw error("cannot integrate backwards from t=%g to t=%g",t,tEnd);
+    if (tEnd==t) return;
+
+    if (ode)
+      {
+        // use dense output, so that repeated calls (for regular
+        // output) do not constrain the solver's step size
+        int err=ode->advanceTo(t, stockVars, tEnd);
+        if (!threadErrMsg.empty())
+          {
+            string msg;
+            msg.swap(threadErrMsg);
+            throw runtime_error(msg);
+          }
+        switch (err)
+          {
+          case GSL_SUCCESS: break;
+          case GSL_FAILURE:
+            throw error("unspecified error GSL_FAILURE returned");
+          case GSL_EBADFUNC: 
+            ode->resetSolver();
+            throw error("Invalid arithmetic operation detected");
+          default:
+            throw error("gsl error: %s",gsl_strerror(err));
+          }
+      }
+    else // do explicit Euler method, as step() does
+      {
+        vector<double> d(stockVars.size());
+        for (; t<tEnd; t+=stepMax)
+          {
+            evalEquations(&d[0], t, &stockVars[0]);
+            for (size_t j=0; j<d.size(); ++j)
+              stockVars[j]+=d[j];
+          }
+      }
+    EvalOpBase::t=t;
+    evalEquations();
+  }
+
+  namespace
+  {
+    const char* checkpointMagic="MinskyCheckpoint";
+    const int checkpointVersion=2;
+
+    /// FNV-1a hash of the layout of variables in the stockVars and
+    /// flowVars vectors, identifying whether a checkpoint's state
+    /// vectors can be applied to the current model
+    uint64_t valueLayoutHash(const VariableValues& values)
+    {
+      uint64_t h=14695981039346656037ULL;
+      auto hash=[&](const void* x, size_t n) {
+        for (size_t i=0; i<n; ++i)
+          h=(h^((const unsigned char*)x)[i])*1099511628211ULL;
+      };
+      for (auto& v: values)
+        {
+          hash(v.first.data(), v.first.size()+1);
+          int64_t layout[]={v.second.isFlowVar(), v.second.idx(), int64_t(v.second.numElements())};
+          hash(layout, sizeof(layout));
+        }
+      return h;
+    }
+
+    vector<PlotWidget*> allPlots(const Group& g)
+    {
+      vector<PlotWidget*> r;
+      g.recursiveDo
+        (&Group::items,
+         [&](const Items&, Items::const_iterator i)
+         {
+           if (auto p=dynamic_cast<PlotWidget*>(i->get()))
+             r.push_back(p);
+           return false;
+         });
+      return r;
+    }
+  }
+  
+  void Minsky::saveCheckpoint(const string& filename)
+  {
+    if (reset_flag())
+      throw error("model has changed since the simulation was started");
+    // the worker may otherwise be updating the state being written
+    pauseSimulationThread();
+    pack_t buf;
+    buf<<string(checkpointMagic)<<checkpointVersion<<valueLayoutHash(variableValues)
+       <<t<<stockVars<<flowVars<<(ode? ode->stepSize(): 0.0);
+    auto plots=allPlots(*model);
+    buf<<unsigned(plots.size());
+    for (auto p: plots)
+      buf<<static_cast<ecolab::Plot&>(*p);
+    ofstream of(filename, ios::binary);
+    of.write(buf.data(), buf.size());
+    if (!of)
+      throw runtime_error("cannot write checkpoint "+filename);
+    lastCheckpoint=t;
+  }
+
+  void Minsky::restoreCheckpoint(const string& filename)
+  {
+    pauseSimulationThread();
+    ifstream inf(filename, ios::binary);
+    if (!inf)
+      throw runtime_error("failed to open "+filename);
+    vector<char> data((istreambuf_iterator<char>(inf)), istreambuf_iterator<char>());
+    pack_t buf(data.size());
+    memcpy(buf.data(), data.data(), data.size());
+    string magic;
+    int version=0;
+    buf>>magic>>version;
+    if (magic!=checkpointMagic || version!=checkpointVersion)
+      throw error("%s is not a Minsky checkpoint",filename.c_str());
+
+    // equations need to be constructed, but the resulting state is
+    // overwritten by the checkpoint
+    if (reset_flag())
+      reset();
+
+    uint64_t layout;
+    double ct, h;
+    vector<double> sv, fv;
+    unsigned numPlots;
+    buf>>layout>>ct>>sv>>fv>>h>>numPlots;
+    auto plots=allPlots(*model);
+    if (layout!=valueLayoutHash(variableValues) ||
+        sv.size()!=stockVars.size() || fv.size()!=flowVars.size() ||
+        numPlots!=plots.size())
+      throw error("checkpoint %s does not match the current model",filename.c_str());
+    for (auto p: plots)
+      buf>>static_cast<ecolab::Plot&>(*p);
+
+    EvalOpBase::t=t=lastCheckpoint=ct;
+    stockVars.swap(sv);
+    flowVars.swap(fv);
+    if (ode && h>0)
+      ode->setStepSize(h);
+    for (auto p: plots)
+      p->redraw();
+    canvas.requestRedraw();
+  }
+
   string Minsky::diagnoseNonFinite() const
   {
     // firstly check if any variables are not finite
@@ -834,17 +1833,18 @@ namespace minsky
 
   void Minsky::evalEquations(double result[], double t, const double vars[])
   {
-    EvalOpBase::t=reverse? -t: t;
-    double reverseFactor=reverse? -1: 1;
-    // firstly evaluate the flow variables. Initialise to flowVars so
-    // that no input vars are correctly initialised
-    vector<double> flow(flowVars);
-    for (size_t i=0; i<equations.size(); ++i)
-      equations[i]->eval(&flow[0], vars);
+    // firstly evaluate the flow variables
+    vector<double> flow;
+    evalFlows(flow, t, vars);
+    evalDerivatives(result, &flow[0], vars);
+  }
 
-    // then create the result using the Godley table
+  void Minsky::evalDerivatives(double result[], const double flow[], const double vars[])
+  {
+    double reverseFactor=(evalContext? evalContext->reverse: reverse)? -1: 1;
+    // create the result using the Godley table
     for (size_t i=0; i<stockVars.size(); ++i) result[i]=0;
-    evalGodley.eval(result, &flow[0]);
+    evalGodley.eval(result, flow);
 
     // integrations are kind of a copy
     for (vector<Integral>::iterator i=integrals.begin(); i<integrals.end(); ++i)
@@ -860,57 +1860,268 @@ namespace minsky
       }
   }
 
-  void Minsky::jacobian(Matrix& jac, double t, const double sv[])
+  void Minsky::evalFlows(vector<double>& flow, double t, const double sv[])
   {
-    EvalOpBase::t=reverse? -t: t;
-    double reverseFactor=reverse? -1: 1;
-    // firstly evaluate the flow variables. Initialise to flowVars so
-    // that no input vars are correctly initialised
-    vector<double> flow=flowVars;
+    EvalOpBase::t=(evalContext? evalContext->reverse: reverse)? -t: t;
+    // Initialise to flowVars so that no input vars are correctly
+    // initialised
+    flow=evalContext? *evalContext->flowVars: flowVars;
     for (size_t i=0; i<equations.size(); ++i)
       equations[i]->eval(&flow[0], sv);
+  }
+
+  void Minsky::evalBranches(vector<double>& branches, double t, const double sv[])
+  {
+    vector<double> flow;
+    evalFlows(flow, t, sv);
+    branches.clear();
+    for (auto& e: discontinuities)
+      branches.push_back(e->branch(sv, &flow[0]));
+  }
+
+  void Minsky::jacobianProduct(double jv[], const double v[], const double sv[], const double flow[],
+                               int param, vector<double>* dflow)
+  {
+    double reverseFactor=(evalContext? evalContext->reverse: reverse)? -1: 1;
+    vector<double> df(flowVars.size());
+    // parameters are not computed by any equation, so the seed propagates unchanged
+    if (param>=0)
+      df[param]=1;
+    for (size_t i=0; i<equations.size(); ++i)
+      equations[i]->deriv(&df[0], v, sv, flow);
+    for (size_t i=0; i<stockVars.size(); ++i) jv[i]=0;
+    evalGodley.eval(jv, &df[0]);
+    for (vector<Integral>::iterator i=integrals.begin(); 
+         i!=integrals.end(); ++i)
+      {
+        assert(i->stock.idx()>=0 && i->input.idx()>=0);
+        jv[i->stock.idx()] = 
+          i->input.isFlowVar()? df[i->input.idx()]: v[i->input.idx()];
+      }
+    for (size_t i=0; i<stockVars.size(); i++)
+      jv[i]*=reverseFactor;
+    if (dflow)
+      dflow->swap(df);
+  }
+
+  void Minsky::jacobian(Matrix& jac, double t, const double sv[])
+  {
+    // firstly evaluate the flow variables
+    vector<double> flow;
+    evalFlows(flow, t, sv);
 
     // then determine the derivatives with respect to variable j
+    vector<double> ds(stockVars.size()), d(stockVars.size());
     for (size_t j=0; j<stockVars.size(); ++j)
       {
-        vector<double> ds(stockVars.size()), df(flowVars.size());
         ds[j]=1;
-        for (size_t i=0; i<equations.size(); ++i)
-          equations[i]->deriv(&df[0], &ds[0], sv, &flow[0]);
-        vector<double> d(stockVars.size());
-        evalGodley.eval(&d[0], &df[0]);
-        for (vector<Integral>::iterator i=integrals.begin(); 
-             i!=integrals.end(); ++i)
+        jacobianProduct(&d[0], &ds[0], sv, &flow[0]);
+        ds[j]=0;
+        for (size_t i=0; i<stockVars.size(); i++)
+          jac(i,j)=d[i];
+      }
+  }
+
+  namespace
+  {
+    double maxNorm(const vector<double>& x)
+    {
+      double r=0;
+      for (auto i: x) r=max(r,fabs(i));
+      return r;
+    }
+  }
+
+  unsigned Minsky::findSteadyState(double tolerance, unsigned maxIterations)
+  {
+    if (reset_flag())
+      reset();
+    pauseSimulationThread();
+    running=false;
+    size_t n=stockVars.size();
+    vector<double> y(stockVars), f(n), dy(n), yTrial(n), fTrial(n), flow;
+    SparseJacobian jacobian(n);
+    SparseMatrix a;
+    SparseLU lu;
+    // entries of the Jacobian that happen to be zero when the pattern is
+    // detected are missed, so redetect it if a step fails
+    bool redetect=true;
+
+    // residual at \a yv, or infinity if it cannot be evaluated there
+    auto residual=[&](const vector<double>& yv, vector<double>& fv) {
+      try
+        {
+          evalEquations(&fv[0], t, &yv[0]);
+          double r=maxNorm(fv);
+          return isfinite(r)? r: numeric_limits<double>::infinity();
+        }
+      catch (const std::exception&)
+        {
+          return numeric_limits<double>::infinity();
+        }
+    };
+
+    // solve (J-I/dtau) dy = -f at y. invDtau=0 gives the Newton step
+    auto solveStep=[&](double invDtau) {
+      try
+        {
+          evalFlows(flow, t, &y[0]);
+          if (redetect)
+            {
+              jacobian.detectPattern(*this, &y[0], &flow[0]);
+              a=jacobian.jac;
+              redetect=false;
+            }
+          else
+            jacobian.evaluate(*this, &y[0], &flow[0]);
+        }
+      catch (const std::exception&)
+        {
+          return false;
+        }
+      auto& jac=jacobian.jac;
+      for (size_t j=0; j<n; ++j)
+        for (size_t p=jac.colStart[j]; p<jac.colStart[j+1]; ++p)
+          a.values[p]=jac.values[p]-(jac.rowIdx[p]==j? invDtau: 0);
+      if (!lu.refactor(a) && !lu.factor(a)) return false;
+      for (size_t i=0; i<n; ++i) dy[i]=-f[i];
+      lu.solve(dy);
+      return isfinite(maxNorm(dy));
+    };
+
+    double norm=residual(y, f);
+    if (!isfinite(norm))
+      throw error("cannot evaluate model at its current state");
+    unsigned iterations=0;
+
+    // damped Newton, halving the step until the residual decreases
+    for (unsigned i=0; norm>tolerance && i<maxIterations; ++i, ++iterations)
+      {
+        double trialNorm=norm;
+        bool freshPattern=redetect;
+        if (solveStep(0))
+          for (double lambda=1; lambda>1e-4; lambda*=0.5)
+            {
+              for (size_t j=0; j<n; ++j) yTrial[j]=y[j]+lambda*dy[j];
+              if ((trialNorm=residual(yTrial, fTrial))<norm) break;
+            }
+        if (!(trialNorm<norm))
           {
-            assert(i->stock.idx()>=0 && i->input.idx()>=0);
-            d[i->stock.idx()] = 
-              i->input.isFlowVar()? df[i->input.idx()]: ds[i->input.idx()];
+            // Newton has stalled, unless the pattern was incomplete
+            if (freshPattern) break;
+            redetect=true;
+            continue;
           }
-        for (size_t i=0; i<stockVars.size(); i++)
-          jac(i,j)=reverseFactor*d[i];
+        y.swap(yTrial);
+        f.swap(fTrial);
+        norm=trialNorm;
       }
-  
+
+    if (norm>tolerance)
+      {
+        // pseudo-transient continuation: implicit Euler steps of
+        // size dtau, grown as the residual falls (switched evolution
+        // relaxation), so that it converges to Newton near the
+        // steady state
+        y=stockVars;
+        norm=residual(y, f);
+        double dtau=stepMax>0? stepMax: 1;
+        for (unsigned i=0; norm>tolerance && i<maxIterations; ++i, ++iterations)
+          {
+            double trialNorm=numeric_limits<double>::infinity();
+            if (solveStep(1/dtau))
+              {
+                for (size_t j=0; j<n; ++j) yTrial[j]=y[j]+dy[j];
+                trialNorm=residual(yTrial, fTrial);
+              }
+            if (!isfinite(trialNorm))
+              {
+                dtau*=0.5;
+                redetect=true;
+                continue;
+              }
+            if (trialNorm>=norm) redetect=true;
+            dtau=min(dtau*norm/trialNorm, 1e100);
+            y.swap(yTrial);
+            f.swap(fTrial);
+            norm=trialNorm;
+          }
+      }
+
+    if (norm>tolerance)
+      throw error("steady state not found after %d iterations, residual %g",
+                  iterations, norm);
+    stockVars=y;
+    if (ode)
+      ode->resetSolver();
+    EvalOpBase::t=t;
+    evalEquations();
+    canvas.requestRedraw();
+    return iterations;
   }
 
   void Minsky::save(const std::string& filename)
   {
-    ofstream of(filename);
-    xml_pack_t saveFile(of, schemaURL);
-    saveFile.prettyPrint=true;
+    // a background save may still be writing the same file
+    waitForBackgroundSave();
     schema2::Minsky m(*this);
-    try
-      {
-        xml_pack(saveFile, "Minsky", m);
-      }
-    catch (...) {
-      // if exception is due to file error, provide a more useful message
-      if (!of)
-        throw runtime_error("cannot save to "+filename);
-      throw;
-    }
+    writeXML(filename, m);
     flags &= ~is_edited;
   }
 
+  void Minsky::saveBinary(const std::string& filename)
+  {
+    // a background save may still be writing the same file
+    waitForBackgroundSave();
+    schema2::Minsky m(*this);
+    writeBinary(filename, m);
+    flags &= ~is_edited;
+  }
+
+  void Minsky::saveInBackground(const std::string& filename, bool binary)
+  {
+    waitForBackgroundSave();
+    // the snapshot is taken on this thread, so the model is not
+    // changed whilst being captured
+    shared_ptr<schema2::Minsky> m(new schema2::Minsky(*this));
+    backgroundSave.reset(new BackgroundSave([=]() {
+          if (binary)
+            writeBinary(filename, *m);
+          else
+            writeXML(filename, *m);
+        }, editCount));
+  }
+
+  void Minsky::completeBackgroundSave()
+  {
+    backgroundSave->thread.join();
+    string errMsg;
+    errMsg.swap(backgroundSave->errMsg);
+    auto snapshotEdits=backgroundSave->editCount;
+    backgroundSave.reset();
+    if (!errMsg.empty())
+      throw runtime_error(errMsg);
+    // the model is only clean if not changed since the snapshot was taken
+    if (snapshotEdits==editCount)
+      flags &= ~is_edited;
+  }
+  
+  void Minsky::waitForBackgroundSave()
+  {
+    if (backgroundSave)
+      completeBackgroundSave();
+  }
+
+  bool Minsky::pollBackgroundSave()
+  {
+    if (!backgroundSave) return true;
+    if (backgroundSave->running) return false;
+    completeBackgroundSave();
+    return true;
+  }
+
+  bool Minsky::backgroundSaveRunning() const
+  {return backgroundSave && backgroundSave->running;}
 
   void Minsky::load(const std::string& filename) 
   {
@@ -919,38 +2130,46 @@ namespace minsky
 
     // current schema
     schema2::Minsky currentSchema;
-    ifstream inf(filename);
+    ifstream inf(filename, ios::binary);
     if (!inf)
       throw runtime_error("failed to open "+filename);
-    xml_unpack_t saveFile(inf);
-    xml_unpack(saveFile, "Minsky", currentSchema);
-
-    switch (currentSchema.schemaVersion)
+    if (isBinarySave(inf))
       {
-      case 0:
-        {
-          schema0::Minsky schema0;
-          xml_unpack(saveFile, "root", schema0);
-          schema1::Minsky schema1(schema0);
-          // fix corruption caused by ticket #329
-          schema1.removeIntVarOrphans();
-          *this=schema2::Minsky(schema1);
-          break;
-        }
-      case 1:
-        {
-          schema1::Minsky schema1;
-          xml_unpack(saveFile, "Minsky", schema1);
-          // fix corruption caused by ticket #329
-          schema1.removeIntVarOrphans();
-          *this=schema2::Minsky(schema1);
-          break;
-        }
-      case 2:
+        readBinary(inf, currentSchema);
         *this = currentSchema;
-        break;
-      default:
-        throw error("Minsky schema version %d not supported",currentSchema.schemaVersion);
+      }
+    else
+      {
+        xml_unpack_t saveFile(inf);
+        xml_unpack(saveFile, "Minsky", currentSchema);
+
+        switch (currentSchema.schemaVersion)
+          {
+          case 0:
+            {
+              schema0::Minsky schema0;
+              xml_unpack(saveFile, "root", schema0);
+              schema1::Minsky schema1(schema0);
+              // fix corruption caused by ticket #329
+              schema1.removeIntVarOrphans();
+              *this=schema2::Minsky(schema1);
+              break;
+            }
+          case 1:
+            {
+              schema1::Minsky schema1;
+              xml_unpack(saveFile, "Minsky", schema1);
+              // fix corruption caused by ticket #329
+              schema1.removeIntVarOrphans();
+              *this=schema2::Minsky(schema1);
+              break;
+            }
+          case 2:
+            *this = currentSchema;
+            break;
+          default:
+            throw error("Minsky schema version %d not supported",currentSchema.schemaVersion);
+          }
       }
 
     // try balancing all Godley tables
@@ -1171,61 +2390,223 @@ namespace minsky
     if (!RKThreadRunning) canvas.requestRedraw();
   }
   
+  namespace
+  {
+    typedef MinskyExclude::HistoryDelta HistoryDelta;
+    
+    /// block size used for matching segments between history states
+    const size_t historyBlock=32;
+    /// a full copy of a state is stored at this interval, bounding
+    /// the cost of reconstructing any state
+    const size_t historyKeyframeInterval=16;
+    /// differences at most this size are checked against the XML
+    /// representation, to eliminate floating point noise
+    const size_t historyNoiseBytes=64;
+
+    /// rolling hash of a block of historyBlock bytes
+    const uint64_t hashBase=1099511628211ULL;
+    uint64_t blockHash(const unsigned char* x)
+    {
+      uint64_t h=0;
+      for (size_t i=0; i<historyBlock; ++i) h=h*hashBase+x[i];
+      return h;
+    }
+    
+    void addSegment(HistoryDelta& d, size_t offset, size_t size)
+    {
+      if (!size) return;
+      if (!d.segments.empty())
+        {
+          auto& last=d.segments.back();
+          if (offset==HistoryDelta::Segment::literal && last.offset==offset)
+            {
+              last.size+=size;
+              return;
+            }
+          if (offset!=HistoryDelta::Segment::literal &&
+              last.offset!=HistoryDelta::Segment::literal &&
+              last.offset+last.size==offset)
+            {
+              last.size+=size;
+              return;
+            }
+        }
+      d.segments.push_back({offset, size});
+    }
+
+    /// compute the delta that recovers state \a from from its successor
+    /// \a to. Blocks of \a to are indexed by hash, and matched
+    /// against every offset of \a from.
+    HistoryDelta historyDelta(const pack_t& from, const pack_t& to)
+    {
+      auto f=(const unsigned char*)from.data(), t=(const unsigned char*)to.data();
+      HistoryDelta d;
+      unordered_map<uint64_t,size_t> blocks;
+      for (size_t o=0; o+historyBlock<=to.size(); o+=historyBlock)
+        blocks.emplace(blockHash(t+o), o);
+
+      uint64_t hashBaseN=1; // hashBase^historyBlock
+      for (size_t i=0; i<historyBlock; ++i) hashBaseN*=hashBase;
+
+      auto literal=[&](size_t b, size_t e) {
+        addSegment(d, HistoryDelta::Segment::literal, e-b);
+        d.literals.insert(d.literals.end(), f+b, f+e);
+      };
+      
+      size_t i=0, literalStart=0;
+      bool hashValid=false;
+      uint64_t h=0;
+      while (i+historyBlock<=from.size())
+        {
+          if (hashValid)
+            h=h*hashBase+f[i+historyBlock-1]-hashBaseN*f[i-1];
+          else
+            h=blockHash(f+i);
+          hashValid=true;
+          auto m=blocks.find(h);
+          if (m!=blocks.end() && memcmp(f+i, t+m->second, historyBlock)==0)
+            {
+              size_t o=m->second, len=historyBlock, back=0;
+              while (i+len<from.size() && o+len<to.size() && f[i+len]==t[o+len])
+                ++len;
+              while (i-back>literalStart && o-back>0 && f[i-back-1]==t[o-back-1])
+                ++back;
+              literal(literalStart, i-back);
+              addSegment(d, o-back, len+back);
+              i+=len;
+              literalStart=i;
+              hashValid=false;
+            }
+          else
+            ++i;
+        }
+      literal(literalStart, from.size());
+      return d;
+    }
+
+    /// apply \a d to \a state, replacing it by the preceding state
+    void applyHistoryDelta(const HistoryDelta& d, vector<char>& state)
+    {
+      vector<char> prev;
+      if (d.keyframe)
+        prev=d.literals;
+      else
+        {
+          auto literal=d.literals.begin();
+          for (auto& s: d.segments)
+            if (s.offset==HistoryDelta::Segment::literal)
+              {
+                prev.insert(prev.end(), literal, literal+s.size);
+                literal+=s.size;
+              }
+            else
+              prev.insert(prev.end(), state.begin()+s.offset,
+                          state.begin()+s.offset+s.size);
+        }
+      prev.swap(state);
+    }
+  }
+
+  void Minsky::clearHistory()
+  {
+    pack_t empty;
+    historyHead.swap(empty);
+    historyStructure.clear();
+    historyDeltas.clear();
+    historyBytes=0;
+    deltasSinceKeyframe=0;
+    historyPtr=0;
+  }
+  
   bool Minsky::pushHistory()
   {
     // go via a schema object, as serialising minsky::Minsky has
     // problems due to port management
     schema2::Minsky m(*this);
-    pack_t buf;
-    buf<<m;
-    if (history.empty())
+    pack_t buf, structure;
+    packHistoryState(buf, m);
+    bool changed=historySize()==0 || buf.size()!=historyHead.size() ||
+      memcmp(buf.data(), historyHead.data(), buf.size())!=0;
+    // before m is overwritten by the comparison below
+    if (changed)
+      packStructure(structure, m);
+    if (changed && historySize()>0)
       {
-        history.emplace_back();
-        buf.swap(history.back());
-        historyPtr=history.size();
-        return true;
+        auto d=historyDelta(historyHead, buf);
+        if (d.literals.size()<=historyNoiseBytes)
+          {
+            // small differences may just be noise in the binary
+            // representation, so check XML versions differ (slower)
+            ostringstream prev, curr;
+            xml_pack_t prevXbuf(prev), currXbuf(curr);
+            xml_pack(currXbuf,"Minsky",m);
+            historyHead.reseto();
+            unpackHistoryState(historyHead, m);
+            xml_pack(prevXbuf,"Minsky",m);
+            changed=curr.str()!=prev.str();
+          }
+        if (changed)
+          {
+            if (++deltasSinceKeyframe>=historyKeyframeInterval)
+              {
+                d.segments.clear();
+                d.literals.assign((const char*)historyHead.data(),
+                                  (const char*)historyHead.data()+historyHead.size());
+                d.keyframe=true;
+                deltasSinceKeyframe=0;
+              }
+            historyDeltas.push_back(move(d));
+            historyBytes+=historyDeltas.back().bytes();
+          }
       }
-    while (history.size()>maxHistory)
-      history.pop_front();
-    if (memcmp(buf.data(), history.back().data(), buf.size())!=0)
+    if (changed)
       {
-        // check XML versions differ (slower)
-        ostringstream prev, curr;
-        xml_pack_t prevXbuf(prev), currXbuf(curr);
-        xml_pack(currXbuf,"Minsky",m);
-        history.back().reseto()>>m;
-        xml_pack(prevXbuf,"Minsky",m);
-
-        if (curr.str()!=prev.str())
+        buf.swap(historyHead);
+        historyStructure.assign((const char*)structure.data(),
+                                (const char*)structure.data()+structure.size());
+        // discard oldest states to keep within budget
+        while (!historyDeltas.empty() &&
+               (historyDeltas.size()>=maxHistory ||
+                historyBytes+historyHead.size()>maxHistoryBytes))
           {
-            // This bit of code outputs an XML representation that can be
-            //        used for debugging issues related to unnecessary
-            //        history pushes.
-            //  buf.reseto()>>m;
-            //  xml_pack_t tb(cout);
-            //  tb.prettyPrint=true;
-            //  xml_pack(tb,"Minsky",m); 
-            //  cout<<"------"<<endl;
-            history.emplace_back();
-            buf.swap(history.back());
-            historyPtr=history.size();
-            return true;
+            historyBytes-=historyDeltas.front().bytes();
+            historyDeltas.pop_front();
           }
       }
-    historyPtr=history.size();
-    return false;
+    historyPtr=historySize();
+    return changed;
+  }
+
+  void Minsky::historyState(size_t i, pack_t& buf) const
+  {
+    // walk backwards from the nearest keyframe, or the most recent state
+    size_t j=i;
+    while (j<historyDeltas.size() && !historyDeltas[j].keyframe) ++j;
+    vector<char> state;
+    if (j<historyDeltas.size())
+      state=historyDeltas[j].literals;
+    else
+      state.assign((const char*)historyHead.data(),
+                   (const char*)historyHead.data()+historyHead.size());
+    for (; j>i; --j)
+      applyHistoryDelta(historyDeltas[j-1], state);
+    pack_t r(state.size());
+    memcpy(r.data(), state.data(), state.size());
+    r.swap(buf);
   }
 
   void Minsky::undo(int changes)
   {
     // save current state for later restoration if needed
-    if (historyPtr==history.size())
+    if (historyPtr==historySize())
       pushHistory();
     historyPtr-=changes;
-    if (historyPtr > 0 && historyPtr <= history.size())
+    if (historyPtr > 0 && historyPtr <= historySize())
       {
         schema2::Minsky m;
-        history[historyPtr-1].reseto()>>m;
+        pack_t buf;
+        historyState(historyPtr-1, buf);
+        unpackHistoryState(buf, m);
         clearAllMaps();
         model->clear();
         m.populateGroup(*model);
@@ -44,6 +44,7 @@
 #include <string>
 #include <set>
 #include <deque>
+#include <atomic>
 
 #include <ecolab.h>
 #include <xml_pack_base.h>
@@ -51,30 +52,31 @@
 using namespace ecolab;
 using namespace classdesc;
 
+namespace schema2
+{
+  struct Minsky;
+}
+
 namespace minsky
 {
   using namespace std;
   using classdesc::shared_ptr;
 
   struct RKdata; // an internal structure for holding Runge-Kutta data
+  struct BackgroundSave; // an internal structure for saving on a worker thread
+  struct SimulationThread; // persistent worker thread running the ODE solver
+  class SimulationLog;
 
   // handle the display of rendered equations on the screen
   class EquationDisplay: public CairoSurface
   {
     Minsky& m;
     double m_width=0, m_height=0;
-    void redraw(int x0, int y0, int width, int height) override {
-      if (surface.get()) {
-        MathDAG::SystemOfEquations system(m);
-        cairo_move_to(surface->cairo(),offsx,offsy);
-        system.renderEquations(*surface);
-        ecolab::cairo::Surface surf
-          (cairo_recording_surface_create(CAIRO_CONTENT_COLOR_ALPHA,NULL));
-        system.renderEquations(surf);
-        m_width=surf.width();
-        m_height=surf.height();
-      }
-    }
+    /// rendered equations, replayed at the pan offset until the
+    /// model is next edited
+    Exclude<cairo::SurfacePtr> cachedEquations;
+    Exclude<Canvas::Timestamp> lastRender;
+    void redraw(int x0, int y0, int width, int height) override;
     CLASSDESC_ACCESS(EquationDisplay);
   public:
     float offsx=0, offsy=0; // pan controls
@@ -90,12 +92,21 @@ namespace minsky
   struct MinskyExclude
   {
     EvalOpVector equations;
+    /// operations among equations that are only piecewise smooth
+    vector<EvalOpPtr> discontinuities;
     vector<Integral> integrals;
     shared_ptr<RKdata> ode;
-    shared_ptr<ofstream> outputDataFile;
+    shared_ptr<SimulationLog> outputDataFile;
+    /// valueIds of the columns of outputDataFile
+    std::vector<std::string> loggedValueIds;
+    shared_ptr<BackgroundSave> backgroundSave;
+    shared_ptr<SimulationThread> simulationThread;
     
     enum StateFlags {is_edited=1, reset_needed=2};
     int flags=reset_needed;
+    /// number of edits made to the model, so that a background save
+    /// can tell whether the model has changed since its snapshot
+    unsigned long editCount=0;
     
     std::vector<int> flagStack;
 
@@ -107,20 +118,76 @@ namespace minsky
     MinskyExclude(const MinskyExclude&): historyPtr(0) {}
     MinskyExclude& operator=(const MinskyExclude&) {return *this;}
     
-    /// used to report a thrown exception on the simulation thread
-    std::string threadErrMsg;
+    /// used to report a thrown exception from within the ODE solver
+    /// to the code driving it. Specific to the calling thread, as the
+    /// solver may be run on the simulation thread or the GUI thread.
+    static thread_local std::string threadErrMsg;
+    /// simulation time of the last checkpoint written
+    double lastCheckpoint=0;
+
+    /// clipboard contents last placed there by this process, along
+    /// with the text form it was placed as
+    mutable shared_ptr<const schema2::Minsky> clipboardSchema;
+    mutable std::string clipboardText;
+
+    /// difference between consecutive history states. The earlier
+    /// state is the concatenation of \a segments, each either copied
+    /// from the later state, or taken in turn from \a literals. A
+    /// keyframe holds the complete earlier state in \a literals.
+    struct HistoryDelta
+    {
+      struct Segment
+      {
+        static const size_t literal=~size_t(0);
+        size_t offset; ///< offset into the later state, or literal
+        size_t size;
+      };
+      std::vector<Segment> segments;
+      std::vector<char> literals;
+      bool keyframe=false;
+      size_t bytes() const
+      {return sizeof(HistoryDelta)+segments.size()*sizeof(Segment)+literals.size();}
+    };
   protected:
-    /// save history of model for undo
-    /* 
-       TODO: it should be sufficient to add move semantics to pack_t,
-       but for some reason copy semantics are required, requiring the
-       use of shared_ptr
-     */
-    std::deque<classdesc::pack_t> history;
+    /// save history of model for undo. The most recent state is held
+    /// in full in historyHead, earlier states as reverse deltas, so
+    /// that state i is obtained from state i+1 by applying
+    /// historyDeltas[i].
+    classdesc::pack_t historyHead;
+    std::deque<HistoryDelta> historyDeltas;
+    size_t historyBytes=0; ///< memory consumed by historyDeltas
+    /// deltas pushed since the last keyframe, which bounds the
+    /// number of deltas applied to reconstruct any state
+    size_t deltasSinceKeyframe=0;
     size_t historyPtr;
+    /// serialised structure of the model recorded in historyHead
+    std::vector<char> historyStructure;
+    /// serialised model structure, and layout of parameters in
+    /// flowVars, as of the last reset. See Minsky::structureChanged()
+    std::vector<char> structureAtReset, parameterLayoutAtReset;
+    /// parameter values edited, but not yet applied to the simulation
+    bool parametersPending=false;
+    /// number of states recorded in history
+    size_t historySize() const {return historyHead.size()? historyDeltas.size()+1: 0;}
 
     /// flag indicates that RK engine is computing a step
-    volatile bool RKThreadRunning=false;
+    std::atomic<bool> RKThreadRunning{false};
+    /// state that equations are evaluated against on the simulation
+    /// thread, being its private copies, as the GUI thread may update
+    /// Minsky's own whilst it runs
+    struct EvalContext
+    {
+      /// values of flow variables not computed by the equations
+      /// (parameters and constants)
+      const std::vector<double>* flowVars;
+      bool reverse;
+    };
+    /// evaluation context of the calling thread. If null, flowVars
+    /// and reverse are used.
+    static thread_local const EvalContext* evalContext;
+    /// flag indicates step() is waiting on the simulation thread
+    bool awaitingStep=false;
+    friend struct SimulationThread;
   };
 
   /// convenience class for accessing matrix elements from a data array
@@ -145,8 +212,18 @@ namespace minsky
     /// NaN. Either a variable name, or and operator type.
     std::string diagnoseNonFinite() const;
 
-    /// write current state of all variables to the log file
-    void logVariables() const;
+    /// serialise the position and size of each parameter in flowVars
+    void parameterLayout(std::vector<char>&) const;
+    /// true if \a structure, as serialised by packStructure(), or the
+    /// parameter layout differs from that at the last reset
+    bool structureChangedFrom(const char* structure, size_t size) const;
+    /// write parameter values from their init expressions into
+    /// flowVars, and continue the simulation from the current state
+    void applyParameterValues();
+    /// join the background save thread, and mark the model as saved
+    /// if successful
+    /// @throw if the save failed
+    void completeBackgroundSave();
 
     Exclude<boost::posix_time::ptime> lastRedraw;
 
@@ -161,8 +238,31 @@ namespace minsky
     /// indicate model has been changed since last saved
     void markEdited() {
       flags |= is_edited | reset_needed;
+      ++editCount;
       canvas.model.updateTimestamp();
     }
+    /// indicate that only parameter values have changed. The new
+    /// values are written into the existing flowVars slots and the
+    /// simulation continues from its current state, rather than
+    /// being reset. Falls back to markEdited() if a parameter's size
+    /// has changed.
+    void markParametersEdited();
+    /// indicate that a parameter's value has been written directly
+    /// into flowVars, as when dragging its slider. The simulation
+    /// picks the value up at its next step, so a rapid succession of
+    /// changes costs at most one solver restart per step, and the
+    /// canvas caches, which do not depend on values, are kept.
+    void markParameterValueSet() {
+      flags |= is_edited;
+      ++editCount;
+      parametersPending=true;
+    }
+    /// true if the model differs from that at the last reset() in
+    /// anything other than parameter values and layout
+    bool structureChanged() const;
+    /// as structureChanged(), but for the model as last recorded by
+    /// pushHistory(), so it need not be serialised again
+    bool historyStructureChanged() const;
 
     /// @{ push and pop state of the flags
     void pushFlags() {flagStack.push_back(flags);}
@@ -210,6 +310,7 @@ namespace minsky
       model->height=model->width=std::numeric_limits<float>::max();
       model->self=model;
     }
+    ~Minsky();
 
     GroupPtr model{new Group};
     Canvas canvas{model};
@@ -248,6 +349,10 @@ namespace minsky
     /// paste clipboard as a new group. canvas.itemFocus is set to
     /// refer to the new group
     void paste();
+    /// duplicate items in current selection as a new group, without
+    /// going via the clipboard. canvas.itemFocus is set to refer to
+    /// the new group
+    void duplicateSelection();
     void saveSelectionAsFile(const string& fileName) const {saveGroupAsFile(canvas.selection,fileName);}
     
     /// @{ override to provide clipboard handling functionality
@@ -269,11 +374,15 @@ namespace minsky
     /// if there are some
     bool cycleCheck() const;
 
-    /// opens the log file, and writes out a header line describing
-    /// names of all variables
+    /// opens the log file, and writes out a header describing names
+    /// of the variables in logVarList. A file name ending in .mlog
+    /// selects the binary columnar format, otherwise text.
     void openLogFile(const string&);
-    /// closes log file
-    void closeLogFile() {outputDataFile.reset();}
+    /// flushes and closes log file
+    /// @throw if any buffered output could not be written
+    void closeLogFile();
+    /// write current state of all variables to the log file
+    void logVariables() const;
     std::set<string> logVarList;
     
     /// construct the equations based on input data
@@ -291,17 +400,103 @@ namespace minsky
 
     typedef MinskyMatrix Matrix; 
     void jacobian(Matrix& jac, double t, const double vars[]);
+    /// evaluate the flow variables at time \a t and stock variables \a sv
+    void evalFlows(vector<double>& flow, double t, const double sv[]);
+    /// evaluate the equations (stockVars.size() of them), given
+    /// stock variables \a vars and the flow variables \a flow
+    /// evaluated from them by evalFlows
+    void evalDerivatives(double result[], const double flow[], const double vars[]);
+    /// evaluate the branches of the piecewise smooth operations at time
+    /// \a t and stock variables \a sv. A change in these over a step
+    /// indicates a discontinuity was crossed.
+    void evalBranches(vector<double>& branches, double t, const double sv[]);
+    /// product of the Jacobian at stock variables \a sv with vector \a v
+    /// @param flow flow variables evaluated at \a sv by evalFlows
+    /// @param param if nonnegative, the flow variable index of a
+    /// parameter, whose partial derivative is added to the product
+    /// @param dflow if not null, receives the corresponding
+    /// derivatives of the flow variables
+    void jacobianProduct(double jv[], const double v[], const double sv[], const double flow[],
+                         int param=-1, vector<double>* dflow=nullptr);
     
     double t{0}; ///< time
     double t0{0}; ///< simulation start time
     bool running=false; ///< controls whether simulation is running
+    /// if true, the simulation thread integrates continuously whilst
+    /// running, and step() picks up the most recent results, rather
+    /// than each step() call advancing the simulation by nSteps
+    bool decoupledSimulation=false;
     bool reverse=false; ///< reverse direction of simulation
+    /// @{ output schedule. If set, each step() advances the simulation
+    /// to the next output time, rather than by nSteps, with the values
+    /// at that time interpolated between the solver's own steps.
+    /// Ignored for explicit Euler and reverse simulation.
+    double outputInterval=0; ///< time between outputs, from t0 (0=unscheduled)
+    std::vector<double> outputTimes; ///< explicit output times in increasing order, overrides outputInterval
+    bool outputScheduled() const {return outputInterval>0 || !outputTimes.empty();}
+    /// next scheduled output time after \a time, or NaN if none
+    double nextOutputTime(double time) const;
+    /// @}
     void reset(); ///<resets the variables back to their initial values
     void step();  ///< step the equations (by n steps, default 1)
-
-    /// save to a file
+    /// integrate the equations on the calling thread up to time \a
+    /// tEnd, without updating icons, plots or the canvas. Intended
+    /// for headless (batch) runs
+    void runUntil(double tEnd);
+    /// bring the simulation thread to a halt, discarding any results
+    /// not yet picked up by step()
+    void pauseSimulationThread();
+    /// solve for a steady state of the model, where
+    /// d(stockVars)/dt=0, by damped Newton iteration from the current
+    /// state, falling back to pseudo-transient continuation from the
+    /// current state if Newton fails. On success, the steady state is
+    /// loaded into stockVars, so subsequent steps continue from it.
+    /// Time is held fixed at the current simulation time.
+    /// @param tolerance maximum absolute value of d(stockVars)/dt accepted
+    /// @param maxIterations limit on the number of iterations of each method
+    /// @return number of iterations performed
+    /// @throw if no steady state was found
+    unsigned findSteadyState(double tolerance=1e-8, unsigned maxIterations=500);
+
+    /// file checkpoints are written to during a simulation
+    std::string checkpointFile;
+    /// simulation time between checkpoints written to checkpointFile
+    /// (0 disables checkpointing)
+    double checkpointInterval=0;
+    /// write the current simulation state (time, stock and flow
+    /// variables, ODE step size and plot data) to \a filename
+    void saveCheckpoint(const std::string& filename);
+    /// restore simulation state written by saveCheckpoint, without
+    /// reinitialising the variables from their initial conditions
+    /// @throw if the checkpoint doesn't match the model's structure
+    void restoreCheckpoint(const std::string& filename);
+
+    /// save to a file, once any background save has completed
+    /// @throw if the background save failed
     void save(const std::string& filename);
-    /// load from a file
+    /// save to a file in a compressed binary format, which is much
+    /// faster than XML for large models. XML remains the interchange
+    /// format - binary files are only readable by the same version of
+    /// Minsky on the same architecture. As with save(), any
+    /// background save is completed first.
+    void saveBinary(const std::string& filename);
+    /// snapshot the model, and save it to \a filename on a background
+    /// thread, so as not to block the GUI
+    /// @param binary save in the binary format rather than XML
+    void saveInBackground(const std::string& filename, bool binary=true);
+    /// wait for any save in progress on the background thread to
+    /// complete. The model is marked as saved only once the save has
+    /// succeeded, and if not edited in the meantime.
+    /// @throw if that save failed
+    void waitForBackgroundSave();
+    /// nonblocking version of waitForBackgroundSave, for the GUI to
+    /// poll on
+    /// @return true if no background save is still being written
+    /// @throw if a save has completed and failed
+    bool pollBackgroundSave();
+    /// true if a background save is still being written
+    bool backgroundSaveRunning() const;
+    /// load from a file (either XML or binary format)
     void load(const std::string& filename);
 
     void exportSchema(const char* filename, int schemaLevel=1);
@@ -326,18 +521,22 @@ namespace minsky
     std::string ravelVersion() const;
 
     unsigned maxHistory{100}; ///< maximum no. of history states to save
+    size_t maxHistoryBytes{100000000}; ///< maximum memory used by history states
     int maxWaitMS=100; ///< maximum  wait in millisecond between redrawing canvaas during simulation
+    int uiLatencyMS=20; ///< maximum delay in milliseconds in processing UI events whilst step() waits
 
     /// clear history
-    void clearHistory() {history.clear(); historyPtr=0;}
+    void clearHistory();
     /// called periodically to ensure history up to date
-    void checkPushHistory() {if (historyPtr==history.size()) pushHistory();}
+    void checkPushHistory() {if (historyPtr==historySize()) pushHistory();}
 
     /// push current model state onto history if it differs from previous
     bool pushHistory();
 
     /// restore model to state \a changes ago 
     void undo(int changes=1);
+    /// reconstruct the \a ith history state into \a buf
+    void historyState(size_t i, classdesc::pack_t& buf) const;
 
     /// set a Tk image to render equations to
     void renderEquationsToImage(const char* image);
@@ -406,6 +605,18 @@ namespace minsky
 #pragma omit xml_pack minsky::MinskyExclude
 #pragma omit xml_unpack minsky::MinskyExclude
 #pragma omit xsd_generate minsky::MinskyExclude
+#pragma omit pack minsky::MinskyExclude::HistoryDelta
+#pragma omit unpack minsky::MinskyExclude::HistoryDelta
+#pragma omit TCL_obj minsky::MinskyExclude::HistoryDelta
+#pragma omit xml_pack minsky::MinskyExclude::HistoryDelta
+#pragma omit xml_unpack minsky::MinskyExclude::HistoryDelta
+#pragma omit xsd_generate minsky::MinskyExclude::HistoryDelta
+#pragma omit pack minsky::MinskyExclude::HistoryDelta::Segment
+#pragma omit unpack minsky::MinskyExclude::HistoryDelta::Segment
+#pragma omit TCL_obj minsky::MinskyExclude::HistoryDelta::Segment
+#pragma omit xml_pack minsky::MinskyExclude::HistoryDelta::Segment
+#pragma omit xml_unpack minsky::MinskyExclude::HistoryDelta::Segment
+#pragma omit xsd_generate minsky::MinskyExclude::HistoryDelta::Segment
 
 #pragma omit xml_pack minsky::Integral
 #pragma omit xml_unpack minsky::Integral
@@ -0,0 +1,181 @@
+/*
+  @copyright Steve Keen 2019
+  @author Russell Standish
+  This file is part of Minsky.
+
+  Minsky is free software: you can redistribute it and/or modify it
+  under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Minsky is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Minsky.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "minsky.h"
+#include "nativeIntegrator.h"
+#include <gsl/gsl_errno.h>
+#include <ecolab_epilogue.h>
+
+#include <algorithm>
+#include <cmath>
+using namespace std;
+
+namespace minsky
+{
+  namespace
+  {
+    // Dormand-Prince 5(4) tableau
+    const double c2=1./5, c3=3./10, c4=4./5, c5=8./9;
+    const double a21=1./5;
+    const double a31=3./40, a32=9./40;
+    const double a41=44./45, a42=-56./15, a43=32./9;
+    const double a51=19372./6561, a52=-25360./2187, a53=64448./6561, a54=-212./729;
+    const double a61=9017./3168, a62=-355./33, a63=46732./5247, a64=49./176, a65=-5103./18656;
+    // fifth order weights, which are also the last row of the tableau (FSAL)
+    const double b1=35./384, b3=500./1113, b4=125./192, b5=-2187./6784, b6=11./84;
+    // difference between the fifth and embedded fourth order weights
+    const double e1=71./57600, e3=-71./16695, e4=71./1920, e5=-17253./339200,
+      e6=22./525, e7=-1./40;
+
+    // Carpenter and Kennedy (1994) RK4(3)5[2N], solution 3
+    const double lsA[]={0, -567301805773./1357537059087, -2404267990393./2016746695238,
+                        -3550918686646./2091501179385, -1275806237668./842570457699};
+    const double lsB[]={1432997174477./9575080441755, 5161836677717./13612068292357,
+                        1720146321549./2090206949498, 3134564353537./4481467310338,
+                        2277821191437./14882151754819};
+    const double lsC[]={0, 1432997174477./9575080441755, 2526269341429./6820363962896,
+                        2006345519317./3224310063776, 2802321613138./2924317926251};
+
+    size_t numStages(RungeKutta::Integrator method)
+    {
+      switch (method)
+        {
+        case RungeKutta::rk4: return 5; // k1-k4 and a temporary
+        case RungeKutta::dormandPrince54: return 9; // k1-k7, a temporary, and y at end of step
+        case RungeKutta::lowStorageRK4: return 2;
+        default: throw error("not a native integration method");
+        }
+    }
+  }
+
+  NativeIntegrator::NativeIntegrator(Minsky& minsky, RungeKutta::Integrator method, size_t dim):
+    minsky(minsky), method(method), dim(dim), work(numStages(method)*dim),
+    h(minsky.stepMax) {}
+
+  const double* NativeIntegrator::fsal() const
+  {return haveFsal? &work[6*dim]: nullptr;}
+
+  int NativeIntegrator::step(double& t, double y[], double tMax)
+  {
+    if (method==RungeKutta::dormandPrince54)
+      return dormandPrinceStep(t, y, tMax);
+    double hs=min(minsky.stepMax, tMax-t);
+    if (method==RungeKutta::rk4)
+      rk4Step(t, hs, y);
+    else
+      lowStorageStep(t, hs, y);
+    t+=hs;
+    return GSL_SUCCESS;
+  }
+
+  void NativeIntegrator::rk4Step(double t, double h, double y[])
+  {
+    double *k1=stage(0), *k2=stage(1), *k3=stage(2), *k4=stage(3), *yt=stage(4);
+    minsky.evalEquations(k1, t, y);
+    for (size_t i=0; i<dim; ++i) yt[i]=y[i]+0.5*h*k1[i];
+    minsky.evalEquations(k2, t+0.5*h, yt);
+    for (size_t i=0; i<dim; ++i) yt[i]=y[i]+0.5*h*k2[i];
+    minsky.evalEquations(k3, t+0.5*h, yt);
+    for (size_t i=0; i<dim; ++i) yt[i]=y[i]+h*k3[i];
+    minsky.evalEquations(k4, t+h, yt);
+    for (size_t i=0; i<dim; ++i)
+      y[i]+=h*(k1[i]+2*(k2[i]+k3[i])+k4[i])/6;
+  }
+
+  void NativeIntegrator::lowStorageStep(double t, double h, double y[])
+  {
+    double *dy=stage(0), *f=stage(1);
+    for (size_t s=0; s<5; ++s)
+      {
+        minsky.evalEquations(f, t+lsC[s]*h, y);
+        for (size_t i=0; i<dim; ++i)
+          {
+            dy[i]=(s? lsA[s]*dy[i]: 0)+h*f[i];
+            y[i]+=lsB[s]*dy[i];
+          }
+      }
+  }
+
+  /// ratio of error to tolerance, in the same form as GSL's standard control
+  double NativeIntegrator::errorRatio(const double y[], const double ynew[], const double err[]) const
+  {
+    double r=0;
+    for (size_t i=0; i<dim; ++i)
+      {
+        double tol=minsky.epsAbs+minsky.epsRel*max(fabs(y[i]),fabs(ynew[i]));
+        r=max(r, fabs(err[i])/tol);
+      }
+    return r;
+  }
+
+  int NativeIntegrator::dormandPrinceStep(double& t, double y[], double tMax)
+  {
+    double *k1=stage(0), *k2=stage(1), *k3=stage(2), *k4=stage(3), *k5=stage(4),
+      *k6=stage(5), *k7=stage(6), *yt=stage(7), *yEnd=stage(8);
+
+    // reuse the last stage of the previous step, if it ended where this one starts
+    if (haveFsal && t==tEnd && equal(y, y+dim, yEnd))
+      copy(k7, k7+dim, k1);
+    else
+      minsky.evalEquations(k1, t, y);
+    haveFsal=false;
+
+    for (;;)
+      {
+        double hs=min(h, tMax-t);
+        for (size_t i=0; i<dim; ++i) yt[i]=y[i]+hs*a21*k1[i];
+        minsky.evalEquations(k2, t+c2*hs, yt);
+        for (size_t i=0; i<dim; ++i) yt[i]=y[i]+hs*(a31*k1[i]+a32*k2[i]);
+        minsky.evalEquations(k3, t+c3*hs, yt);
+        for (size_t i=0; i<dim; ++i) yt[i]=y[i]+hs*(a41*k1[i]+a42*k2[i]+a43*k3[i]);
+        minsky.evalEquations(k4, t+c4*hs, yt);
+        for (size_t i=0; i<dim; ++i)
+          yt[i]=y[i]+hs*(a51*k1[i]+a52*k2[i]+a53*k3[i]+a54*k4[i]);
+        minsky.evalEquations(k5, t+c5*hs, yt);
+        for (size_t i=0; i<dim; ++i)
+          yt[i]=y[i]+hs*(a61*k1[i]+a62*k2[i]+a63*k3[i]+a64*k4[i]+a65*k5[i]);
+        minsky.evalEquations(k6, t+hs, yt);
+        for (size_t i=0; i<dim; ++i)
+          yEnd[i]=y[i]+hs*(b1*k1[i]+b3*k3[i]+b4*k4[i]+b5*k5[i]+b6*k6[i]);
+        minsky.evalEquations(k7, t+hs, yEnd);
+        // error estimate, stored in yt
+        for (size_t i=0; i<dim; ++i)
+          yt[i]=hs*(e1*k1[i]+e3*k3[i]+e4*k4[i]+e5*k5[i]+e6*k6[i]+e7*k7[i]);
+        double r=errorRatio(y, yEnd, yt);
+        if (!isfinite(r))
+          return GSL_EBADFUNC;
+
+        if (r<=1)
+          {
+            t+=hs;
+            copy(yEnd, yEnd+dim, y);
+            tEnd=t;
+            haveFsal=true;
+            // only grow the step if it was not truncated to land on tMax
+            if (hs==h)
+              h*= r>0? min(5.0, 0.9*pow(r,-0.2)): 5;
+            h=min(h, minsky.stepMax);
+            return GSL_SUCCESS;
+          }
+        h=hs*max(0.2, 0.9*pow(r,-0.25));
+        if (h<minsky.stepMin || t+h==t)
+          return GSL_ENOPROG;
+      }
+  }
+}
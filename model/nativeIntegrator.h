@@ -0,0 +1,70 @@
+/*
+  @copyright Steve Keen 2019
+  @author Russell Standish
+  This file is part of Minsky.
+
+  Minsky is free software: you can redistribute it and/or modify it
+  under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Minsky is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Minsky.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef NATIVEINTEGRATOR_H
+#define NATIVEINTEGRATOR_H
+#include "rungeKutta.h"
+#include <vector>
+#include <stddef.h>
+
+namespace minsky
+{
+  class Minsky;
+
+  /// Explicit Runge-Kutta integrators calling Minsky::evalEquations
+  /// directly, rather than via the GSL driver. Stage vectors are held
+  /// contiguously in a single buffer allocated up front, so stepping
+  /// performs no allocations of its own.
+  /// - rk4: classical fourth order, fixed step size stepMax
+  /// - dormandPrince54: adaptive fifth order with embedded fourth
+  ///   order error estimate, reusing the last stage of a step as the
+  ///   first stage of the next (FSAL)
+  /// - lowStorageRK4: Carpenter and Kennedy's five stage, fourth
+  ///   order 2N storage scheme, fixed step size stepMax
+  class NativeIntegrator
+  {
+    Minsky& minsky;
+    RungeKutta::Integrator method;
+    size_t dim;
+    std::vector<double> work; ///< stage buffers
+    double* stage(size_t i) {return &work[i*dim];}
+    /// state at the end of the last step, to check validity of the FSAL stage
+    double tEnd;
+    bool haveFsal=false;
+    double errorRatio(const double y[], const double ynew[], const double err[]) const;
+    void rk4Step(double t, double h, double y[]);
+    void lowStorageStep(double t, double h, double y[]);
+    int dormandPrinceStep(double& t, double y[], double tMax);
+  public:
+    /// current step size
+    double h;
+    NativeIntegrator(Minsky& minsky, RungeKutta::Integrator method, size_t dim);
+    /// advance \a t and \a y by one step, not going beyond \a tMax
+    /// @return GSL_SUCCESS, or GSL_ENOPROG if the adaptive step size
+    /// falls below stepMin
+    int step(double& t, double y[], double tMax);
+    /// derivative at the end of the last step, if computed as part of
+    /// that step, otherwise nullptr
+    const double* fsal() const;
+    /// discard information about previous steps
+    void reset() {haveFsal=false;}
+  };
+}
+
+#endif
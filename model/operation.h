@@ -77,6 +77,7 @@ namespace minsky
     virtual void addPorts();
 
     void draw(cairo_t*) const override;
+    bool iconCacheable() const override {return true;}
 
     /// current value of output port
     double value() const override;
@@ -195,6 +196,9 @@ namespace minsky
       assert(intVar);
       return ports.size()>0 && intVar->ports.size()>0 && ports[0]==intVar->ports[0];
     }
+    /// a coupled integration variable displays its value, and is
+    /// positioned by draw()
+    bool iconCacheable() const override {return !coupled();}
     Units units(bool) const override;
 
     void pack(pack_t& x, const string& d) const override;
@@ -20,43 +20,220 @@
 #include "panopticon.h"
 #include "ecolab_epilogue.h"
 using namespace minsky;
+using namespace std;
 
-void Panopticon::redraw(int, int, int w, int h)
+namespace
 {
-  // cache results of canvas image size
-  if (canvas.model.timestamp>lastBoundsCheck || !cachedImage.get())
+  /// size in pixels of the tiles the overview is rasterised in
+  const int tileSize=64;
+
+  /// margin around items and wires, at unit zoom, covering ports,
+  /// arrowheads and selection highlights
+  const float margin=10;
+
+  /// boxes equal to within rounding, as coordinates at unit zoom are
+  /// computed from those at the canvas's zoom
+  bool sameBox(const SpatialBox& x, const SpatialBox& y)
+  {
+    const float eps=0.01;
+    return fabs(x.x0-y.x0)<eps && fabs(x.y0-y.y0)<eps &&
+      fabs(x.x1-y.x1)<eps && fabs(x.y1-y.y1)<eps;
+  }
+}
+
+void Panopticon::updateTiles(int w, int h)
+{
+  double zf=canvas.model->zoomFactor(), mx=canvas.model->x(), my=canvas.model->y();
+  auto unitBox=[&](float x0, float y0, float x1, float y1) {
+    return SpatialBox((min(x0,x1)-mx)/zf-margin, (min(y0,y1)-my)/zf-margin,
+                      (max(x0,x1)-mx)/zf+margin, (max(y0,y1)-my)/zf+margin);
+  };
+
+  // appearance of the model now, and its extent
+  unordered_map<const void*, Rendered> current;
+  SpatialBox extent;
+  bool empty=true;
+  auto add=[&](const void* key, const Rendered& r) {
+    if (empty) extent=r.box; else extent.extend(r.box);
+    empty=false;
+    current.emplace(key, r);
+  };
+  auto addItem=[&](const ItemPtr& i) {
+    if (!i->visible()) return;
+    Rendered r;
+    r.item=i;
+    r.box=unitBox(i->left(), i->top(), i->right(), i->bottom());
+    r.updates=i->bb.updates();
+    r.selected=i->selected;
+    r.rotation=i->rotation;
+    add(i.get(), r);
+  };
+  canvas.model->recursiveDo
+    (&GroupItems::items, [&](const Items&, Items::const_iterator i)
+     {addItem(*i); return false;});
+  canvas.model->recursiveDo
+    (&GroupItems::groups, [&](const Groups&, Groups::const_iterator i)
+     {addItem(*i); return false;});
+  canvas.model->recursiveDo
+    (&GroupItems::wires, [&](const Wires&, Wires::const_iterator i)
+     {
+       if (!(*i)->visible()) return false;
+       Rendered r;
+       r.wire=*i;
+       r.coords=(*i)->coords();
+       SpatialBox b(r.coords[0],r.coords[1],r.coords[0],r.coords[1]);
+       for (size_t j=2; j+1<r.coords.size(); j+=2)
+         b.extend(SpatialBox(r.coords[j],r.coords[j+1],r.coords[j],r.coords[j+1]));
+       r.box=unitBox(b.x0,b.y0,b.x1,b.y1);
+       add(i->get(), r);
+       return false;
+     });
+
+  double scale=0;
+  if (!empty && extent.x1>extent.x0 && extent.y1>extent.y0)
+    scale=min(w/(extent.x1-extent.x0), h/(extent.y1-extent.y0));
+  int nx=(w+tileSize-1)/tileSize, ny=(h+tileSize-1)/tileSize;
+  // rerender everything if the overview's size, scale or origin has
+  // changed by more than rounding
+  bool all=nx!=tilesX || ny!=tilesY || tiles.size()!=size_t(nx*ny) ||
+    fabs(scale-imageScale)>1e-4*scale ||
+    fabs(extent.x0-imageLeft)*scale>0.1 || fabs(extent.y0-imageTop)*scale>0.1;
+
+  // regions of the model whose appearance has changed
+  vector<SpatialBox> changed;
+  if (!all)
     {
-      lastBoundsCheck=Canvas::Timestamp::clock::now();
-      cachedImage.reset(new cairo::Surface
-                            (cairo_recording_surface_create(CAIRO_CONTENT_COLOR,nullptr)));
-      cachedImage.swap(canvas.surface);
-      // render at zoom=1, 0,0
-      double zf=canvas.model->zoomFactor(), x=canvas.model->x(), y=canvas.model->y();
-      canvas.model->zoom(x,y,1/zf);
-      canvas.model->moveTo(0,0);
-      canvas.redraw();
-      canvas.model->moveTo(x,y);
-      canvas.model->zoom(x,y,zf);
-      cachedImage.swap(canvas.surface);
+      for (auto& r: rendered)
+        {
+          auto c=current.find(r.first);
+          if (c!=current.end() && c->second.item.lock()==r.second.item.lock() &&
+              c->second.wire.lock()==r.second.wire.lock() &&
+              sameBox(c->second.box, r.second.box) && c->second.updates==r.second.updates &&
+              c->second.selected==r.second.selected && c->second.rotation==r.second.rotation &&
+              c->second.coords==r.second.coords)
+            continue;
+          changed.push_back(r.second.box);
+          if (c!=current.end())
+            changed.push_back(c->second.box);
+        }
+      for (auto& c: current)
+        if (!rendered.count(c.first))
+          changed.push_back(c.second.box);
+    }
+  rendered.swap(current);
+
+  if (all)
+    {
+      tiles.assign(nx*ny, nullptr);
+      tilesX=nx; tilesY=ny;
+      imageScale=scale;
+      imageLeft=extent.x0;
+      imageTop=extent.y0;
     }
-  
-  double xscale=w/cachedImage->width(), yscale=h/cachedImage->height();
-  double scale=min(xscale,yscale);
-//  cairo_rectangle(surface->cairo(),0,0,w,h);
-//  cairo_clip(surface->cairo());
-  cairo_scale(surface->cairo(),scale,scale);
-  //cout << "scale:"<<scale<<endl;
   // Heuristic to not render when scale is too small for things to be visible
-  if (scale>0.03)
+  if (imageScale<=0.03)
     {
-      cairo_set_source_surface(surface->cairo(), cachedImage->surface(), -cachedImage->left(),-cachedImage->top());
-      cairo_paint(surface->cairo());
+      tiles.assign(nx*ny, nullptr);
+      return;
     }
+
+  // tiles to rerender, and the region they cover
+  vector<size_t> dirty;
+  SpatialBox region;
+  double unitTile=tileSize/imageScale;
+  for (int j=0; j<tilesY; ++j)
+    for (int i=0; i<tilesX; ++i)
+      {
+        SpatialBox tile(imageLeft+i*unitTile, imageTop+j*unitTile,
+                        imageLeft+(i+1)*unitTile, imageTop+(j+1)*unitTile);
+        bool rerender=all;
+        for (auto& b: changed)
+          rerender|=b.intersects(tile);
+        if (!rerender) continue;
+        if (dirty.empty()) region=tile; else region.extend(tile);
+        dirty.push_back(j*tilesX+i);
+      }
+  if (dirty.empty()) return;
+
+  // record the canvas over that region at its current zoom, which
+  // avoids relaying out the model, and reuses the canvas's cached
+  // icons. Items are simplified as they would be at unit zoom, which
+  // collapses their ports, so port positions are restored afterwards.
+  struct PortPosition
+  {
+    shared_ptr<Port> port;
+    float x, y;
+  };
+  vector<PortPosition> ports;
+  auto savePorts=[&](const Item& i) {
+    for (auto& p: i.ports)
+      ports.push_back({p, p->x(), p->y()});
+  };
+  canvas.model->recursiveDo
+    (&GroupItems::items, [&](const Items&, Items::const_iterator i)
+     {savePorts(**i); return false;});
+  canvas.model->recursiveDo
+    (&GroupItems::groups, [&](const Groups&, Groups::const_iterator i)
+     {savePorts(**i); return false;});
+
+  cairo::SurfacePtr recording
+    (new cairo::Surface(cairo_recording_surface_create(CAIRO_CONTENT_COLOR,nullptr)));
+  auto minDetailSize=canvas.minDetailSize;
+  canvas.minDetailSize*=zf;
+  recording.swap(canvas.surface);
+  int x0=floor(region.x0*zf+mx)-1, y0=floor(region.y0*zf+my)-1;
+  canvas.redraw(x0, y0, ceil(region.x1*zf+mx)+1-x0, ceil(region.y1*zf+my)+1-y0);
+  recording.swap(canvas.surface);
+  canvas.minDetailSize=minDetailSize;
+  for (auto& p: ports)
+    p.port->moveTo(p.x, p.y);
+
+  // rasterise the tiles at the displayed scale, so subsequent redraws
+  // are independent of model size
+  for (auto k: dirty)
+    {
+      int i=k%tilesX, j=k/tilesX;
+      auto& tile=tiles[k];
+      tile.reset(new cairo::Surface
+                 (cairo_image_surface_create(CAIRO_FORMAT_ARGB32,tileSize,tileSize)));
+      auto cairo=tile->cairo();
+      cairo_scale(cairo,imageScale/zf,imageScale/zf);
+      // canvas coordinates of the tile's origin
+      cairo_translate(cairo, -(mx+zf*(imageLeft+i*unitTile)), -(my+zf*(imageTop+j*unitTile)));
+      cairo_set_source_surface(cairo, recording->surface(), 0, 0);
+      cairo_paint(cairo);
+    }
+}
+
+void Panopticon::redraw(int, int, int w, int h)
+{
+  double zf=canvas.model->zoomFactor(), mx=canvas.model->x(), my=canvas.model->y();
+  // rerender only if the model has changed. The overview is of the
+  // model at unit zoom, so panning and zooming just move the
+  // indicator rectangle.
+  if (canvas.model.timestamp>lastBoundsCheck || tiles.empty() ||
+      w!=imageWidth || h!=imageHeight)
+    {
+      lastBoundsCheck=Canvas::Timestamp::clock::now();
+      updateTiles(w,h);
+      imageWidth=w; imageHeight=h;
+    }
+
+  auto cairo=surface->cairo();
+  for (int j=0; j<tilesY; ++j)
+    for (int i=0; i<tilesX; ++i)
+      if (auto& tile=tiles[j*tilesX+i])
+        {
+          cairo_set_source_surface(cairo, tile->surface(), i*tileSize, j*tileSize);
+          cairo_rectangle(cairo, i*tileSize, j*tileSize, tileSize, tileSize);
+          cairo_fill(cairo);
+        }
   
-  // draw indicator rectangle
-  double zf=1/canvas.model->zoomFactor();
-  cairo_rectangle(surface->cairo(),-cachedImage->left()-canvas.model->x(),-cachedImage->top()-canvas.model->y(),zf*width,zf*height);
-  cairo_set_source_rgba(surface->cairo(),0,0,0,0.5);
-  cairo_fill(surface->cairo());
+  // draw indicator rectangle, being the canvas window in model
+  // coordinates at unit zoom
+  cairo_rectangle(cairo, imageScale*(-mx/zf-imageLeft), imageScale*(-my/zf-imageTop),
+                  imageScale*width/zf, imageScale*height/zf);
+  cairo_set_source_rgba(cairo,0,0,0,0.5);
+  cairo_fill(cairo);
   surface->blit();
 }
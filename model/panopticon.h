@@ -21,22 +21,58 @@
 #define PANOPTICON_H
 #include <cairoSurfaceImage.h>
 #include <canvas.h>
+#include <unordered_map>
 
 namespace minsky
 {
   struct Panopticon: public ecolab::CairoSurface
   {
+    CLASSDESC_ACCESS(Panopticon);
     double cleft=0, ctop=0, cwidth=0, cheight=0;
     Exclude<Canvas::Timestamp> lastBoundsCheck;
     double width=0,height=0;
     Canvas& canvas;
-    Exclude<cairo::SurfacePtr> cachedImage;
+    /// overview of the canvas, rasterised at the scale displayed, as
+    /// rows of tilesX tiles. When the model changes, only tiles
+    /// covering items and wires that have changed are rerendered.
+    Exclude<std::vector<cairo::SurfacePtr>> tiles;
+    int tilesX=0, tilesY=0;
+    /// panopticon size at which tiles were rendered
+    int imageWidth=0, imageHeight=0;
+    /// scale and origin of tiles relative to the model at unit zoom
+    double imageScale=1, imageLeft=0, imageTop=0;
     Panopticon(Canvas& canvas): canvas(canvas)  {}
     void redraw(int, int, int width, int height) override;
     void requestRedraw() {if (surface.get()) surface->requestRedraw();}
 
     Panopticon& operator=(const Panopticon&) {return *this;}
+  private:
+    /// appearance of an item or wire when tiles were rendered, in
+    /// model coordinates at unit zoom
+    struct Rendered
+    {
+      std::weak_ptr<Item> item;
+      std::weak_ptr<Wire> wire;
+      SpatialBox box;
+      unsigned updates=0; ///< of the item's bounding box
+      bool selected=false;
+      double rotation=0;
+      std::vector<float> coords; ///< of the wire
+    };
+    Exclude<std::unordered_map<const void*, Rendered>> rendered;
+    /// rerender tiles for a panopticon of size \a w x \a h
+    void updateTiles(int w, int h);
   };
 }
+
+#ifdef _CLASSDESC
+#pragma omit pack minsky::Panopticon::Rendered
+#pragma omit unpack minsky::Panopticon::Rendered
+#pragma omit TCL_obj minsky::Panopticon::Rendered
+#pragma omit xml_pack minsky::Panopticon::Rendered
+#pragma omit xml_unpack minsky::Panopticon::Rendered
+#pragma omit xsd_generate minsky::Panopticon::Rendered
+#endif
+
 #include "panopticon.cd"
 #endif
@@ -42,8 +42,14 @@ namespace minsky
 
   void Port::moveTo(float x, float y)
   {
-    m_x=x-item.x();
-    m_y=y-item.y();
+    float dx=x-item.x(), dy=y-item.y();
+    if (dx==m_x && dy==m_y) return;
+    m_x=dx;
+    m_y=dy;
+    // attached wires may be indexed by any enclosing group
+    if (!m_wires.empty())
+      for (auto g=group(); g; g=g->group.lock())
+        g->spatialIndex.invalidateWires();
   }
 
   GroupPtr Port::group() const
@@ -76,6 +76,7 @@ namespace minsky
     string ravelVersion() const; ///< Ravel version string
     const char* lastErr() const;
     void draw(cairo_t* cairo) const override;
+    bool iconCacheable() const override {return false;}
     void resize(const LassoBox&) override;
     double radius() const;
     ClickType::Type clickType(float x, float y) override;
@@ -0,0 +1,196 @@
+/*
+  @copyright Steve Keen 2019
+  @author Russell Standish
+  This file is part of Minsky.
+
+  Minsky is free software: you can redistribute it and/or modify it
+  under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Minsky is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Minsky.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "rosenbrock.h"
+#include "sparseJacobian.h"
+#include "minsky.h"
+#include <gsl/gsl_errno.h>
+#include <ecolab_epilogue.h>
+
+#include <algorithm>
+#include <limits>
+#include <math.h>
+using namespace std;
+
+namespace minsky
+{
+  namespace
+  {
+    const double ros2Gamma=1+1/sqrt(2.0);
+    /// number of steps a Jacobian is used for before being recomputed
+    const unsigned maxJacobianAge=20;
+
+    struct Ros2State
+    {
+      size_t dim;
+      SparseJacobian jacobian;
+      /// I-γhJ, with the same structure as the Jacobian
+      SparseMatrix w;
+      SparseLU lu;
+      bool haveJac=false;
+      double luH=0; ///< step size for which lu is valid, 0 if not valid
+      unsigned jacAge=0, retries=0;
+      double lastT=nan("");
+      vector<double> k1, k2, ft, ytmp, flow;
+
+      Ros2State(size_t dim): dim(dim), jacobian(dim), k1(dim), k2(dim), ft(dim),
+                             ytmp(dim) {}
+
+      void detectPattern(Minsky& m, const double y[]);
+      void evalJacobian(Minsky& m, const double y[]);
+      bool factor(double h);
+    };
+
+    void Ros2State::detectPattern(Minsky& m, const double y[])
+    {
+      jacobian.detectPattern(m, y, &flow[0]);
+      w=jacobian.jac;
+      luH=0;
+    }
+
+    void Ros2State::evalJacobian(Minsky& m, const double y[])
+    {
+      jacobian.evaluate(m, y, &flow[0]);
+      luH=0;
+    }
+
+    /// factor I-γhJ. Only the values change between calls while the
+    /// pattern is stable, so the symbolic analysis is reused when the
+    /// previous pivots remain acceptable
+    bool Ros2State::factor(double h)
+    {
+      auto& jac=jacobian.jac;
+      for (size_t j=0; j<dim; ++j)
+        for (size_t p=jac.colStart[j]; p<jac.colStart[j+1]; ++p)
+          w.values[p]=(jac.rowIdx[p]==j)-ros2Gamma*h*jac.values[p];
+      if (!lu.refactor(w) && !lu.factor(w))
+        return false;
+      luH=h;
+      return true;
+    }
+
+    void* ros2Alloc(size_t dim)
+    {return new Ros2State(dim);}
+
+    int ros2Apply(void* vstate, size_t dim, double t, double h, double y[],
+                  double yerr[], const double dydt_in[], double dydt_out[],
+                  const gsl_odeiv2_system* sys)
+    {
+      auto& s=*static_cast<Ros2State*>(vstate);
+      auto& m=*static_cast<Minsky*>(sys->params);
+      int err;
+      try
+        {
+          // a repeated call at the same time means the previous
+          // attempt was rejected, so refresh the Jacobian, and then
+          // its sparsity pattern
+          if (t==s.lastT)
+            ++s.retries;
+          else
+            {
+              s.retries=0;
+              s.lastT=t;
+            }
+          if (!s.haveJac || s.jacAge>=maxJacobianAge || s.retries>0)
+            {
+              m.evalFlows(s.flow, t, y);
+              if (!s.jacobian.havePattern || s.retries==2)
+                s.detectPattern(m, y);
+              else
+                s.evalJacobian(m, y);
+              s.haveJac=true;
+              s.jacAge=0;
+            }
+          if (h!=s.luH && !s.factor(h))
+            return GSL_FAILURE; // singular - try a smaller step
+
+          // stage 1
+          if (dydt_in)
+            copy(dydt_in, dydt_in+dim, s.k1.begin());
+          else if ((err=GSL_ODEIV_FN_EVAL(sys, t, y, &s.k1[0]))!=GSL_SUCCESS)
+            return err;
+          // explicit time dependence, by finite difference, scaled by γh
+          double dt=sqrt(numeric_limits<double>::epsilon())*max(1.0,fabs(t));
+          if ((err=GSL_ODEIV_FN_EVAL(sys, t+dt, y, &s.ft[0]))!=GSL_SUCCESS)
+            return err;
+          for (size_t i=0; i<dim; ++i)
+            {
+              s.ft[i]=ros2Gamma*h*(s.ft[i]-s.k1[i])/dt;
+              s.k1[i]+=s.ft[i];
+            }
+          s.lu.solve(s.k1);
+
+          // stage 2
+          for (size_t i=0; i<dim; ++i)
+            s.ytmp[i]=y[i]+h*s.k1[i];
+          if ((err=GSL_ODEIV_FN_EVAL(sys, t+h, &s.ytmp[0], &s.k2[0]))!=GSL_SUCCESS)
+            return err;
+          for (size_t i=0; i<dim; ++i)
+            s.k2[i]-=2*s.k1[i]+s.ft[i];
+          s.lu.solve(s.k2);
+        }
+      catch (const std::exception& ex)
+        {
+          m.threadErrMsg=ex.what();
+          return GSL_EBADFUNC;
+        }
+
+      for (size_t i=0; i<dim; ++i)
+        {
+          // difference from the embedded first order solution y+hk1
+          yerr[i]=0.5*h*(s.k1[i]+s.k2[i]);
+          y[i]+=h*(1.5*s.k1[i]+0.5*s.k2[i]);
+        }
+      ++s.jacAge;
+      if (dydt_out)
+        return GSL_ODEIV_FN_EVAL(sys, t+h, y, dydt_out);
+      return GSL_SUCCESS;
+    }
+
+    int ros2SetDriver(void*, const gsl_odeiv2_driver*)
+    {return GSL_SUCCESS;}
+
+    int ros2Reset(void* vstate, size_t)
+    {
+      auto& s=*static_cast<Ros2State*>(vstate);
+      s.haveJac=false;
+      s.luH=0;
+      s.lastT=nan("");
+      return GSL_SUCCESS;
+    }
+
+    unsigned ros2Order(void*) {return 2;}
+
+    void ros2Free(void* vstate)
+    {delete static_cast<Ros2State*>(vstate);}
+
+    const gsl_odeiv2_step_type ros2sparseType=
+      {"ros2sparse",
+       1, // can use dydt_in
+       1, // gives exact dydt_out
+       &ros2Alloc,
+       &ros2Apply,
+       &ros2SetDriver,
+       &ros2Reset,
+       &ros2Order,
+       &ros2Free};
+  }
+
+  const gsl_odeiv2_step_type* step_ros2sparse=&ros2sparseType;
+}
@@ -0,0 +1,38 @@
+/*
+  @copyright Steve Keen 2019
+  @author Russell Standish
+  This file is part of Minsky.
+
+  Minsky is free software: you can redistribute it and/or modify it
+  under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Minsky is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Minsky.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef ROSENBROCK_H
+#define ROSENBROCK_H
+#include <gsl/gsl_odeiv2.h>
+
+namespace minsky
+{
+  /// GSL stepper implementing the two stage, second order, L-stable
+  /// Rosenbrock method ROS2 (Verwer et al, SIAM J Sci Comput 20,
+  /// 1456, 1999) for stiff systems, using a sparse Jacobian and sparse
+  /// LU factorisation. The Jacobian is computed from Minsky::jacobianProduct
+  /// with structurally orthogonal columns sharing a single product,
+  /// and is reused across steps, as ROS2 retains its order with an
+  /// approximate Jacobian. Explicit time dependence is handled by a
+  /// finite difference. The system's params must point to the Minsky
+  /// object being integrated.
+  extern const gsl_odeiv2_step_type* step_ros2sparse;
+}
+
+#endif
@@ -0,0 +1,151 @@
+/*
+  @copyright Steve Keen 2019
+  @author Russell Standish
+  This file is part of Minsky.
+
+  Minsky is free software: you can redistribute it and/or modify it
+  under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Minsky is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Minsky.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "sensitivity.h"
+#include "minsky.h"
+#include <gsl/gsl_errno.h>
+#include <ecolab_epilogue.h>
+using namespace std;
+
+namespace minsky
+{
+  SensitivityAnalysis::SensitivityAnalysis
+  (Minsky& minsky, const vector<string>& parameters, const vector<string>& outputNames):
+    minsky(minsky)
+  {
+    if (minsky.reset_flag())
+      minsky.reset();
+    minsky.pauseSimulationThread();
+    if (minsky.reverse)
+      throw error("sensitivity analysis not supported in reverse simulation");
+
+    dim=minsky.stockVars.size();
+    t=minsky.t;
+    y.resize(dim*(parameters.size()+1));
+    copy(minsky.stockVars.begin(), minsky.stockVars.end(), y.begin());
+    for (size_t k=0; k<parameters.size(); ++k)
+      {
+        auto v=minsky.variableValues.find(parameters[k]);
+        if (v==minsky.variableValues.end())
+          throw error("variable %s not found in model",parameters[k].c_str());
+        switch (v->second.type())
+          {
+          case VariableType::parameter:
+            paramIdx.push_back(v->second.idx());
+            break;
+          case VariableType::stock: case VariableType::integral:
+            // sensitivity to the initial value starts as a unit vector
+            paramIdx.push_back(-1);
+            y[dim*(k+1)+v->second.idx()]=1;
+            break;
+          default:
+            throw error("%s is not a parameter or stock variable",parameters[k].c_str());
+          }
+      }
+    for (auto& i: outputNames)
+      {
+        auto v=minsky.variableValues.find(i);
+        if (v==minsky.variableValues.end() || v->second.idx()<0)
+          throw error("variable %s not found in model",i.c_str());
+        outputs.push_back(Output{v->second.isFlowVar(), v->second.idx()});
+      }
+
+    sys.function=rhs;
+    sys.jacobian=nullptr;
+    sys.dimension=y.size();
+    sys.params=this;
+    // the augmented system has no Jacobian available, so an explicit
+    // adaptive stepper is used regardless of the model's solver settings
+    driver=gsl_odeiv2_driver_alloc_y_new
+      (&sys, gsl_odeiv2_step_rkf45, minsky.stepMax, minsky.epsAbs, minsky.epsRel);
+    gsl_odeiv2_driver_set_hmax(driver, minsky.stepMax);
+    gsl_odeiv2_driver_set_hmin(driver, minsky.stepMin);
+  }
+
+  SensitivityAnalysis::~SensitivityAnalysis()
+  {if (driver) gsl_odeiv2_driver_free(driver);}
+
+  void SensitivityAnalysis::evalRHS(double t, const double y[], double dydt[])
+  {
+    minsky.evalFlows(flow, t, y);
+    minsky.evalDerivatives(dydt, &flow[0], y);
+    for (size_t k=0; k<paramIdx.size(); ++k)
+      minsky.jacobianProduct(dydt+dim*(k+1), y+dim*(k+1), y, &flow[0], paramIdx[k]);
+  }
+
+  int SensitivityAnalysis::rhs(double t, const double y[], double dydt[], void* params)
+  {
+    auto& self=*static_cast<SensitivityAnalysis*>(params);
+    try
+      {
+        self.evalRHS(t, y, dydt);
+      }
+    catch (std::exception& e)
+      {
+        self.minsky.threadErrMsg=e.what();
+        return GSL_EBADFUNC;
+      }
+    return GSL_SUCCESS;
+  }
+
+  void SensitivityAnalysis::runUntil(double tEnd)
+  {
+    if (tEnd<t)
+      throw error("cannot integrate backwards from t=%g to t=%g",t,tEnd);
+    // the GUI may have restarted the simulation since construction
+    minsky.pauseSimulationThread();
+    int err=gsl_odeiv2_driver_apply(driver, &t, tEnd, &y[0]);
+    copy(y.begin(), y.begin()+dim, minsky.stockVars.begin());
+    minsky.t=t;
+    EvalOpBase::t=t;
+    minsky.evalEquations();
+    if (!minsky.threadErrMsg.empty())
+      {
+        string msg;
+        msg.swap(minsky.threadErrMsg);
+        throw runtime_error(msg);
+      }
+    if (err!=GSL_SUCCESS)
+      throw error("gsl error: %s",gsl_strerror(err));
+  }
+
+  vector<double> SensitivityAnalysis::values() const
+  {
+    vector<double> r;
+    for (auto& i: outputs)
+      r.push_back(i.flow? minsky.flowVars[i.idx]: minsky.stockVars[i.idx]);
+    return r;
+  }
+
+  vector<vector<double>> SensitivityAnalysis::gradients()
+  {
+    vector<vector<double>> r(outputs.size(), vector<double>(paramIdx.size()));
+    vector<double> jv(dim);
+    minsky.pauseSimulationThread();
+    minsky.evalFlows(flow, t, &y[0]);
+    for (size_t k=0; k<paramIdx.size(); ++k)
+      {
+        const double* s=&y[dim*(k+1)];
+        minsky.jacobianProduct(&jv[0], s, &y[0], &flow[0], paramIdx[k], &dflow);
+        for (size_t i=0; i<outputs.size(); ++i)
+          r[i][k]=outputs[i].flow? dflow[outputs[i].idx]: s[outputs[i].idx];
+      }
+    return r;
+  }
+}
@@ -0,0 +1,74 @@
+/*
+  @copyright Steve Keen 2019
+  @author Russell Standish
+  This file is part of Minsky.
+
+  Minsky is free software: you can redistribute it and/or modify it
+  under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Minsky is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Minsky.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef SENSITIVITY_H
+#define SENSITIVITY_H
+#include <gsl/gsl_odeiv2.h>
+#include <string>
+#include <vector>
+
+namespace minsky
+{
+  class Minsky;
+
+  /// Forward sensitivity analysis. Integrates the model together
+  /// with the sensitivity equations ds_k/dt = J s_k + ∂f/∂p_k for each
+  /// selected parameter p_k, where J is the Jacobian and f the right
+  /// hand side of the model, using the derivatives provided by the
+  /// evaluation operations. A single run yields the selected outputs
+  /// and their gradients with respect to all selected parameters.
+  class SensitivityAnalysis
+  {
+    Minsky& minsky;
+    size_t dim; ///< number of stock variables
+    /// flow variable indices of parameters, or -1 for initial conditions
+    std::vector<int> paramIdx;
+    struct Output {bool flow; int idx;};
+    std::vector<Output> outputs;
+    /// stock variables, followed by their sensitivities to each parameter
+    std::vector<double> y;
+    double t;
+    std::vector<double> flow, dflow;
+    gsl_odeiv2_system sys;
+    gsl_odeiv2_driver* driver=nullptr;
+    static int rhs(double t, const double y[], double dydt[], void* params);
+    void evalRHS(double t, const double y[], double dydt[]);
+  public:
+    /// start an analysis from the model's current state
+    /// @param parameters valueIds of parameters, or of stock variables
+    /// for sensitivity with respect to their initial values
+    /// @param outputs valueIds of the variables whose gradients are required
+    SensitivityAnalysis(Minsky& minsky, const std::vector<std::string>& parameters,
+                        const std::vector<std::string>& outputs);
+    ~SensitivityAnalysis();
+    SensitivityAnalysis(const SensitivityAnalysis&)=delete;
+    void operator=(const SensitivityAnalysis&)=delete;
+
+    /// integrate up to time \a tEnd, leaving the model's variables at
+    /// their values at that time
+    void runUntil(double tEnd);
+    /// current values of the outputs
+    std::vector<double> values() const;
+    /// gradients()[i][k] is the derivative of output i with respect
+    /// to parameter k at the current time
+    std::vector<std::vector<double>> gradients();
+  };
+}
+
+#endif
@@ -90,10 +90,12 @@ void Sheet::draw(cairo_t* cairo) const
               if (value.xVector.size()==2)
                 y+=rowHeight; // allow room for header row
 
-              // draw in label column
+              // draw in label column. Only rows within the sheet
+              // are laid out, as the remainder are clipped anyway
               string format=value.xVector[0].timeFormat();
               for (auto& i: value.xVector[0])
                 {
+                  if (y>0.5*m_height) break;
                   cairo_move_to(cairo,x,y);
                   pango.setText(trimWS(str(i,format)));
                   pango.show();
@@ -105,6 +107,7 @@ void Sheet::draw(cairo_t* cairo) const
               if (value.xVector.size()==1)
                 for (auto v: value)
                   {
+                    if (y>0.5*m_height) break;
                     cairo_move_to(cairo,x,y);
                     pango.setMarkup(str(v));
                     pango.show();
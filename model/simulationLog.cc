@@ -0,0 +1,223 @@
+/*
+  @copyright Steve Keen 2019
+  @author Russell Standish
+  This file is part of Minsky.
+
+  Minsky is free software: you can redistribute it and/or modify it
+  under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Minsky is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Minsky.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "simulationLog.h"
+#include <stdexcept>
+#include <string.h>
+using namespace std;
+
+namespace minsky
+{
+  const char* SimulationLog::magic="MinskyLog";
+
+  namespace
+  {
+    template <class T>
+    void writeRaw(ostream& o, const T& x)
+    {o.write(reinterpret_cast<const char*>(&x), sizeof(x));}
+
+    template <class T>
+    void readRaw(istream& i, T& x)
+    {i.read(reinterpret_cast<char*>(&x), sizeof(x));}
+  }
+
+  SimulationLog::SimulationLog
+  (const string& filename, const vector<string>& names,
+   const vector<Slot>& slots, Format format):
+    file(filename, format==binary? ios::binary|ios::out: ios::out),
+    format(format), slots(slots)
+  {
+    if (!file)
+      throw runtime_error("cannot open "+filename);
+    if (format==binary)
+      {
+        file.write(magic, strlen(magic));
+        writeRaw(file, uint32_t(version));
+        writeRaw(file, uint32_t(names.size()+1));
+        auto writeName=[&](const string& name) {
+          writeRaw(file, uint32_t(name.size()));
+          file.write(name.data(), name.size());
+        };
+        writeName("time");
+        for (auto& n: names) writeName(n);
+      }
+    else
+      {
+        file<<"#time";
+        for (auto& n: names)
+          file<<" "<<n;
+        file<<"\n";
+      }
+    current.reserve(blockRows*(slots.size()+1));
+    writer=boost::thread([this]() {run();});
+  }
+
+  SimulationLog::~SimulationLog()
+  {
+    try {submit();}
+    catch (...) {} // nowhere to report write errors from here
+    {
+      boost::lock_guard<boost::mutex> lock(mutex);
+      shutdown=true;
+    }
+    cond.notify_all();
+    writer.join();
+  }
+
+  SimulationLog::Format SimulationLog::formatFor(const string& filename)
+  {
+    static const string ext=".mlog";
+    return filename.size()>ext.size() &&
+      filename.compare(filename.size()-ext.size(), ext.size(), ext)==0?
+      binary: text;
+  }
+
+  void SimulationLog::checkError()
+  {
+    if (!errMsg.empty())
+      throw runtime_error(errMsg);
+  }
+
+  void SimulationLog::append(double t)
+  {
+    current.push_back(t);
+    for (auto& s: slots)
+      current.push_back(s());
+    if (current.size()>=blockRows*(slots.size()+1))
+      submit();
+  }
+
+  void SimulationLog::setSlots(const vector<Slot>& newSlots)
+  {
+    if (newSlots.size()!=slots.size())
+      throw runtime_error("number of logged values cannot be changed");
+    slots=newSlots;
+  }
+
+  void SimulationLog::submit()
+  {
+    if (current.empty()) return;
+    boost::unique_lock<boost::mutex> lock(mutex);
+    while (queue.size()>=maxQueuedBlocks && errMsg.empty())
+      cond.wait(lock);
+    checkError();
+    queue.emplace_back();
+    queue.back().swap(current);
+    current.reserve(blockRows*(slots.size()+1));
+    cond.notify_all();
+  }
+
+  void SimulationLog::flush()
+  {
+    submit();
+    boost::unique_lock<boost::mutex> lock(mutex);
+    while ((!queue.empty() || writing) && errMsg.empty())
+      cond.wait(lock);
+    checkError();
+  }
+
+  void SimulationLog::run()
+  {
+    boost::unique_lock<boost::mutex> lock(mutex);
+    for (;;)
+      {
+        while (queue.empty() && !shutdown)
+          cond.wait(lock);
+        if (queue.empty()) break; // shutdown with nothing left to write
+        Block block;
+        block.swap(queue.front());
+        queue.pop_front();
+        writing=true;
+        cond.notify_all(); // wake any appender waiting for space
+        lock.unlock();
+        write(block);
+        lock.lock();
+        writing=false;
+        if (!file && errMsg.empty())
+          errMsg="error writing simulation log";
+        cond.notify_all();
+      }
+    file.flush();
+  }
+
+  void SimulationLog::write(const Block& block)
+  {
+    size_t cols=slots.size()+1, rows=block.size()/cols;
+    if (format==binary)
+      {
+        // transpose to column major, so each column is contiguous
+        writeRaw(file, uint32_t(rows));
+        vector<double> column(rows);
+        for (size_t c=0; c<cols; ++c)
+          {
+            for (size_t r=0; r<rows; ++r)
+              column[r]=block[r*cols+c];
+            file.write(reinterpret_cast<const char*>(column.data()),
+                       rows*sizeof(double));
+          }
+      }
+    else
+      for (size_t r=0; r<rows; ++r)
+        {
+          file<<block[r*cols];
+          for (size_t c=1; c<cols; ++c)
+            file<<" "<<block[r*cols+c];
+          file<<"\n";
+        }
+  }
+
+  void SimulationLog::readBinary
+  (const string& filename, vector<string>& names, vector<vector<double>>& columns)
+  {
+    ifstream f(filename, ios::binary);
+    if (!f)
+      throw runtime_error("cannot open "+filename);
+    string m(strlen(magic),'\0');
+    f.read(&m[0], m.size());
+    uint32_t v=0, cols=0;
+    readRaw(f, v);
+    if (!f || m!=magic || v!=version)
+      throw runtime_error(filename+" is not a Minsky binary log file");
+    readRaw(f, cols);
+    names.resize(cols);
+    for (auto& n: names)
+      {
+        uint32_t len=0;
+        readRaw(f, len);
+        n.resize(len);
+        f.read(&n[0], len);
+      }
+    columns.clear();
+    columns.resize(cols);
+    for (;;)
+      {
+        uint32_t rows=0;
+        readRaw(f, rows);
+        if (f.eof() && f.gcount()==0) break;
+        for (auto& c: columns)
+          {
+            size_t start=c.size();
+            c.resize(start+rows);
+            if (f) f.read(reinterpret_cast<char*>(&c[start]), rows*sizeof(double));
+          }
+        if (!f)
+          throw runtime_error(filename+" is truncated");
+      }
+  }
+}
@@ -0,0 +1,116 @@
+/*
+  @copyright Steve Keen 2019
+  @author Russell Standish
+  This file is part of Minsky.
+
+  Minsky is free software: you can redistribute it and/or modify it
+  under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Minsky is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Minsky.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef SIMULATIONLOG_H
+#define SIMULATIONLOG_H
+
+#include <boost/thread.hpp>
+#include <cmath>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace minsky
+{
+  /// Buffered log of simulation values. Rows are accumulated into
+  /// blocks, which are written out by a background thread, so the
+  /// simulation only pays for copying the logged values.
+  ///
+  /// Two file formats are supported: the original space separated
+  /// text format with a "#time name..." header line, and a binary
+  /// columnar format (selected by a .mlog extension), consisting of:
+  /// - the magic string "MinskyLog", uint32 version, uint32 number of columns
+  /// - for each column, uint32 name length followed by the name
+  /// - a sequence of blocks, each being a uint32 number of rows,
+  ///   followed by that many doubles for each column in turn.
+  /// The first column is always time. All integers and doubles are
+  /// stored in native byte order.
+  class SimulationLog
+  {
+  public:
+    /// location of a logged value
+    struct Slot
+    {
+      const std::vector<double>* values;
+      size_t idx;
+      double operator()() const
+      {return idx<values->size()? (*values)[idx]: std::nan("");}
+    };
+    enum Format {text, binary};
+
+    /// @param names column names (excluding time)
+    /// @param slots location of each column's value
+    SimulationLog(const std::string& filename, const std::vector<std::string>& names,
+                  const std::vector<Slot>& slots, Format format);
+    /// flushes any buffered rows before closing the file
+    ~SimulationLog();
+
+    /// record the current values of all slots at time \a t
+    /// @throw if a previous write failed
+    void append(double t);
+    /// relocate the logged values, eg after the value vectors have
+    /// been reallocated. \a slots must correspond to the original columns.
+    void setSlots(const std::vector<Slot>& slots);
+    /// wait for all rows so far to be written to the file
+    /// @throw if a write failed
+    void flush();
+
+    /// format selected by the file name
+    static Format formatFor(const std::string& filename);
+
+    /// read a binary log file, as written by this class
+    /// @param names column names, including time
+    /// @param columns data of each column
+    static void readBinary(const std::string& filename, std::vector<std::string>& names,
+                           std::vector<std::vector<double>>& columns);
+
+    static const char* magic;
+    static const uint32_t version=1;
+    /// number of rows per block
+    static const size_t blockRows=1024;
+    /// maximum number of full blocks queued before append() waits on the writer
+    static const size_t maxQueuedBlocks=64;
+
+  private:
+    typedef std::vector<double> Block; // row major, time in first column
+    std::ofstream file;
+    Format format;
+    std::vector<Slot> slots;
+    Block current;
+
+    boost::mutex mutex;
+    boost::condition_variable cond;
+    std::deque<Block> queue;
+    bool writing=false, shutdown=false;
+    std::string errMsg;
+    boost::thread writer;
+
+    void run();
+    void write(const Block&);
+    void submit();
+    void checkError();
+
+    SimulationLog(const SimulationLog&)=delete;
+    void operator=(const SimulationLog&)=delete;
+  };
+}
+
+#endif
@@ -0,0 +1,107 @@
+/*
+  @copyright Steve Keen 2019
+  @author Russell Standish
+  This file is part of Minsky.
+
+  Minsky is free software: you can redistribute it and/or modify it
+  under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Minsky is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Minsky.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "sparseJacobian.h"
+#include "minsky.h"
+#include <ecolab_epilogue.h>
+
+#include <algorithm>
+using namespace std;
+
+namespace minsky
+{
+  /// construct jac's structure from pattern
+  void SparseJacobian::buildMatrix()
+  {
+    jac=SparseMatrix();
+    jac.n=dim;
+    for (auto& col: pattern)
+      {
+        jac.rowIdx.insert(jac.rowIdx.end(), col.begin(), col.end());
+        jac.colStart.push_back(jac.rowIdx.size());
+      }
+    jac.values.resize(jac.rowIdx.size());
+  }
+
+  /// greedy colouring of the columns such that no two columns of
+  /// the same colour have a row in common
+  void SparseJacobian::colourColumns()
+  {
+    vector<vector<size_t>> rowCols(dim);
+    for (size_t j=0; j<dim; ++j)
+      for (auto i: pattern[j])
+        rowCols[i].push_back(j);
+    vector<long> colour(dim,-1);
+    vector<size_t> usedBy; // column that last excluded each colour
+    colours.clear();
+    for (size_t j=0; j<dim; ++j)
+      {
+        for (auto i: pattern[j])
+          for (auto k: rowCols[i])
+            if (colour[k]>=0)
+              usedBy[colour[k]]=j;
+        size_t c=0;
+        while (c<colours.size() && usedBy[c]==j) ++c;
+        if (c==colours.size())
+          {
+            colours.emplace_back();
+            usedBy.push_back(dim);
+          }
+        colour[j]=c;
+        colours[c].push_back(j);
+      }
+  }
+
+  void SparseJacobian::detectPattern(Minsky& m, const double y[], const double flow[])
+  {
+    vector<vector<double>> colValues(dim);
+    for (size_t j=0; j<dim; ++j)
+      {
+        v[j]=1;
+        m.jacobianProduct(&jv[0], &v[0], y, flow);
+        v[j]=0;
+        auto& col=pattern[j];
+        for (size_t i=0; i<dim; ++i)
+          if ((jv[i]!=0 || i==j) && !binary_search(col.begin(), col.end(), i))
+            col.insert(upper_bound(col.begin(), col.end(), i), i);
+        for (auto i: col)
+          colValues[j].push_back(jv[i]);
+      }
+    buildMatrix();
+    colourColumns();
+    for (size_t j=0; j<dim; ++j)
+      copy(colValues[j].begin(), colValues[j].end(), jac.values.begin()+jac.colStart[j]);
+    havePattern=true;
+  }
+
+  void SparseJacobian::evaluate(Minsky& m, const double y[], const double flow[])
+  {
+    for (auto& cols: colours)
+      {
+        for (auto j: cols) v[j]=1;
+        m.jacobianProduct(&jv[0], &v[0], y, flow);
+        for (auto j: cols)
+          {
+            v[j]=0;
+            for (size_t p=jac.colStart[j]; p<jac.colStart[j+1]; ++p)
+              jac.values[p]=jv[jac.rowIdx[p]];
+          }
+      }
+  }
+}
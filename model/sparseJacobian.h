@@ -0,0 +1,61 @@
+/*
+  @copyright Steve Keen 2019
+  @author Russell Standish
+  This file is part of Minsky.
+
+  Minsky is free software: you can redistribute it and/or modify it
+  under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Minsky is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Minsky.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef SPARSEJACOBIAN_H
+#define SPARSEJACOBIAN_H
+#include "sparseLU.h"
+#include <vector>
+#include <stddef.h>
+
+namespace minsky
+{
+  class Minsky;
+
+  /// Jacobian of a model's stock variable derivatives, assembled
+  /// directly in compressed column form from Minsky::jacobianProduct.
+  /// The sparsity pattern is found from one product per column, after
+  /// which structurally orthogonal columns share a single product.
+  class SparseJacobian
+  {
+    size_t dim;
+    /// nonzero rows of each column, including the diagonal
+    std::vector<std::vector<size_t>> pattern;
+    /// groups of columns with no rows in common
+    std::vector<std::vector<size_t>> colours;
+    std::vector<double> v, jv;
+    void buildMatrix();
+    void colourColumns();
+  public:
+    /// the Jacobian. The diagonal is always present in the pattern
+    SparseMatrix jac;
+    bool havePattern=false;
+    explicit SparseJacobian(size_t dim): dim(dim), pattern(dim), v(dim), jv(dim) {}
+    /// compute the Jacobian at stock variables \a y column by column,
+    /// adding any entries not previously seen to the sparsity
+    /// pattern. Entries that happen to be zero at the time are not
+    /// detected.
+    /// @param flow flow variables evaluated at \a y by Minsky::evalFlows
+    void detectPattern(Minsky& m, const double y[], const double flow[]);
+    /// compute the Jacobian at \a y within the existing pattern, with
+    /// one product per group of structurally orthogonal columns
+    void evaluate(Minsky& m, const double y[], const double flow[]);
+  };
+}
+
+#endif
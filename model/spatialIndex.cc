@@ -0,0 +1,169 @@
+/*
+  @copyright Steve Keen 2019
+  @author Russell Standish
+  This file is part of Minsky.
+
+  Minsky is free software: you can redistribute it and/or modify it
+  under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Minsky is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Minsky.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "spatialIndex.h"
+#include "group.h"
+#include "wire.h"
+#include <ecolab_epilogue.h>
+using namespace std;
+
+namespace minsky
+{
+  namespace
+  {
+    /// minimum grid cell size, to bound the number of cells small
+    /// objects are registered in
+    const float minCellSize=10;
+
+    template <class T>
+    void setCellSize(SpatialGrid<T>& grid, const vector<SpatialBox>& boxes)
+    {
+      float sum=0;
+      size_t n=0;
+      for (auto& b: boxes)
+        if (b.bounded())
+          {
+            sum+=max(b.x1-b.x0, b.y1-b.y0);
+            ++n;
+          }
+      grid.cellSize=max(minCellSize, n? sum/n: minCellSize);
+    }
+  }
+
+  float SpatialIndex::transform(const Group& g, float& x0, float& y0)
+  {
+    x0=g.x(); y0=g.y();
+    return g.zoomFactor()*g.relZoom;
+  }
+
+  SpatialBox SpatialIndex::box(const Group& g, const Item& i)
+  {
+    if (i.ioVar())
+      return SpatialBox::everywhere();
+    float x0, y0, z=transform(g,x0,y0);
+    // ratio of item's scale to that of the group's contents, which
+    // differs for variables attached to Godley icons
+    float r=i.zoomFactor()/z;
+    float w=0.5*i.width(), h=0.5*i.height(); // updates bb if necessary
+    // union of the hit region used by Item::contains, and the icon
+    // used by LassoBox::intersects
+    SpatialBox b(-w,-h,w,h);
+    SpatialBox hit;
+    i.bb.extent(hit.x0,hit.y0,hit.x1,hit.y1);
+    b.extend(hit);
+    return SpatialBox(r*(i.m_x+b.x0), r*(i.m_y+b.y0), r*(i.m_x+b.x1), r*(i.m_y+b.y1));
+  }
+
+  void SpatialIndex::insert(const shared_ptr<Item>& i)
+  {
+    if (!itemsValid) return;
+    auto g=i->group.lock();
+    if (g && i->bb.valid())
+      m_items.insert(i, box(*g,*i));
+    else
+      // defer computing the bounding box until the next query
+      itemsValid=false;
+  }
+
+  void SpatialIndex::update(const Item& i)
+  {
+    if (!itemsValid || !m_items.contains(&i)) return;
+    auto g=i.group.lock();
+    if (g && i.bb.valid())
+      m_items.move(&i, box(*g,i));
+    else
+      itemsValid=false;
+  }
+
+  void SpatialIndex::remove(const Item& i)
+  {
+    m_items.remove(&i);
+    wiresValid=false;
+  }
+
+  void SpatialIndex::checkItems(const Group& g)
+  {
+    if (itemsValid) return;
+    m_items.clear();
+    // computing boxes may update bounding boxes, which calls back
+    // into update(), ignored until the index is valid
+    vector<SpatialBox> boxes;
+    for (auto& i: g.items)
+      boxes.push_back(box(g,*i));
+    setCellSize(m_items, boxes);
+    for (size_t i=0; i<boxes.size(); ++i)
+      m_items.insert(g.items[i], boxes[i]);
+    itemsValid=true;
+  }
+
+  void SpatialIndex::checkWires(const Group& g)
+  {
+    float x0, y0, z=transform(g,x0,y0);
+    if (wiresValid && x0==wireX && y0==wireY && z==wireZoom) return;
+    m_wires.clear();
+    vector<SpatialBox> boxes;
+    for (auto& w: g.wires)
+      {
+        auto c=w->coords();
+        SpatialBox b(c[0],c[1],c[0],c[1]);
+        for (size_t j=2; j<c.size()-1; j+=2)
+          b.extend(SpatialBox(c[j],c[j+1],c[j],c[j+1]));
+        // Wire::near accepts points whose distances to a straight
+        // wire's ends sum to less than its length+5
+        float pad=0;
+        if (c.size()==4)
+          {
+            float d=sqrt((c[2]-c[0])*(c[2]-c[0])+(c[3]-c[1])*(c[3]-c[1]));
+            pad=max(2.5f, 0.5f*sqrt(10*d+25));
+          }
+        boxes.emplace_back(b.x0-pad, b.y0-pad, b.x1+pad, b.y1+pad);
+      }
+    setCellSize(m_wires, boxes);
+    for (size_t i=0; i<boxes.size(); ++i)
+      m_wires.insert(g.wires[i], boxes[i]);
+    wireX=x0; wireY=y0; wireZoom=z;
+    wiresValid=true;
+  }
+
+  vector<shared_ptr<Item>> SpatialIndex::itemsAt(const Group& g, float x, float y)
+  {
+    checkItems(g);
+    float x0, y0, z=transform(g,x0,y0);
+    return m_items.at((x-x0)/z, (y-y0)/z);
+  }
+
+  vector<shared_ptr<Item>> SpatialIndex::itemsIn(const Group& g, const SpatialBox& b)
+  {
+    checkItems(g);
+    float x0, y0, z=transform(g,x0,y0);
+    return m_items.in(SpatialBox((b.x0-x0)/z, (b.y0-y0)/z, (b.x1-x0)/z, (b.y1-y0)/z));
+  }
+
+  vector<shared_ptr<Wire>> SpatialIndex::wiresAt(const Group& g, float x, float y)
+  {
+    checkWires(g);
+    return m_wires.at(x,y);
+  }
+
+  vector<shared_ptr<Wire>> SpatialIndex::wiresIn(const Group& g, const SpatialBox& b)
+  {
+    checkWires(g);
+    return m_wires.in(b);
+  }
+}
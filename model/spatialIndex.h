@@ -0,0 +1,340 @@
+/*
+  @copyright Steve Keen 2019
+  @author Russell Standish
+  This file is part of Minsky.
+
+  Minsky is free software: you can redistribute it and/or modify it
+  under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Minsky is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Minsky.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef SPATIALINDEX_H
+#define SPATIALINDEX_H
+#include <algorithm>
+#include <limits>
+#include <math.h>
+#include <memory>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace minsky
+{
+  class Item;
+  class Wire;
+  class Group;
+
+  /// axis aligned rectangle, with y increasing downwards
+  struct SpatialBox
+  {
+    float x0=0, y0=0, x1=0, y1=0;
+    SpatialBox() {}
+    SpatialBox(float x0, float y0, float x1, float y1): x0(x0), y0(y0), x1(x1), y1(y1) {}
+    bool contains(float x, float y) const {return x>=x0 && x<=x1 && y>=y0 && y<=y1;}
+    bool intersects(const SpatialBox& b) const
+    {return x1>=b.x0 && x0<=b.x1 && y1>=b.y0 && y0<=b.y1;}
+    /// distance from (x,y) to the nearest point of the box
+    float distance(float x, float y) const {
+      float dx=std::max(std::max(x0-x, x-x1), 0.0f), dy=std::max(std::max(y0-y, y-y1), 0.0f);
+      return sqrt(dx*dx+dy*dy);
+    }
+    void extend(const SpatialBox& b) {
+      x0=std::min(x0,b.x0); y0=std::min(y0,b.y0);
+      x1=std::max(x1,b.x1); y1=std::max(y1,b.y1);
+    }
+    /// box covering the whole plane, for objects whose extent cannot
+    /// be indexed
+    static SpatialBox everywhere() {
+      float inf=std::numeric_limits<float>::infinity();
+      return SpatialBox(-inf,-inf,inf,inf);
+    }
+    bool bounded() const {return std::isfinite(x0) && std::isfinite(x1) && std::isfinite(y0) && std::isfinite(y1);}
+  };
+
+  /// Uniform grid of objects of type T, each registered in every cell
+  /// its bounding box overlaps. Objects are held by weak reference,
+  /// and query results are returned in order of insertion.
+  template <class T>
+  class SpatialGrid
+  {
+    struct Entry
+    {
+      std::weak_ptr<T> obj;
+      SpatialBox box;
+      size_t seq;
+    };
+    std::vector<Entry> entries;
+    std::vector<size_t> freeSlots;
+    std::unordered_map<const T*, size_t> slot;
+    std::unordered_map<unsigned long long, std::vector<size_t>> cells;
+    /// entries that are tested by every query
+    std::vector<size_t> unbounded;
+    size_t nextSeq=0;
+    /// range of cells occupied
+    long cx0=0, cy0=0, cx1=-1, cy1=-1;
+
+    long cell(float x) const {return long(floor(x/cellSize));}
+    static unsigned long long key(long i, long j)
+    {return (static_cast<unsigned long long>(i)<<32) | (static_cast<unsigned long long>(j)&0xffffffff);}
+
+    void addToCells(size_t s) {
+      auto& b=entries[s].box;
+      if (!b.bounded())
+        {
+          unbounded.push_back(s);
+          return;
+        }
+      long i0=cell(b.x0), i1=cell(b.x1), j0=cell(b.y0), j1=cell(b.y1);
+      if (cx1<cx0) {cx0=i0; cx1=i1; cy0=j0; cy1=j1;}
+      cx0=std::min(cx0,i0); cx1=std::max(cx1,i1);
+      cy0=std::min(cy0,j0); cy1=std::max(cy1,j1);
+      for (long i=i0; i<=i1; ++i)
+        for (long j=j0; j<=j1; ++j)
+          cells[key(i,j)].push_back(s);
+    }
+    void removeFromCells(size_t s) {
+      auto& b=entries[s].box;
+      if (!b.bounded())
+        {
+          unbounded.erase(std::remove(unbounded.begin(), unbounded.end(), s), unbounded.end());
+          return;
+        }
+      for (long i=cell(b.x0); i<=cell(b.x1); ++i)
+        for (long j=cell(b.y0); j<=cell(b.y1); ++j)
+          {
+            auto c=cells.find(key(i,j));
+            if (c==cells.end()) continue;
+            c->second.erase(std::remove(c->second.begin(), c->second.end(), s), c->second.end());
+            if (c->second.empty()) cells.erase(c);
+          }
+    }
+    /// live objects from slots \a s, in order of insertion
+    std::vector<std::shared_ptr<T>> objects(std::vector<size_t>& s) const {
+      std::sort(s.begin(), s.end(), [this](size_t i, size_t j)
+                {return entries[i].seq<entries[j].seq;});
+      s.erase(std::unique(s.begin(), s.end()), s.end());
+      std::vector<std::shared_ptr<T>> r;
+      for (auto i: s)
+        if (auto o=entries[i].obj.lock())
+          r.push_back(o);
+      return r;
+    }
+  public:
+    /// should be comparable to the size of typical objects. Only
+    /// change when the grid is empty.
+    float cellSize=50;
+
+    void clear() {
+      entries.clear(); freeSlots.clear(); slot.clear(); cells.clear(); unbounded.clear();
+      cx0=cy0=0; cx1=cy1=-1;
+    }
+    size_t size() const {return slot.size();}
+    bool contains(const T* o) const {return slot.count(o);}
+
+    /// add \a o, or move it if already present
+    void insert(const std::shared_ptr<T>& o, const SpatialBox& b) {
+      auto i=slot.find(o.get());
+      size_t s;
+      if (i!=slot.end())
+        {
+          s=i->second;
+          removeFromCells(s);
+        }
+      else
+        {
+          if (freeSlots.empty())
+            {
+              s=entries.size();
+              entries.emplace_back();
+            }
+          else
+            {
+              s=freeSlots.back();
+              freeSlots.pop_back();
+            }
+          slot[o.get()]=s;
+          entries[s].obj=o;
+          entries[s].seq=nextSeq++;
+        }
+      entries[s].box=b;
+      addToCells(s);
+    }
+
+    /// update the bounding box of \a o, if present
+    void move(const T* o, const SpatialBox& b) {
+      auto i=slot.find(o);
+      if (i==slot.end()) return;
+      removeFromCells(i->second);
+      entries[i->second].box=b;
+      addToCells(i->second);
+    }
+
+    void remove(const T* o) {
+      auto i=slot.find(o);
+      if (i==slot.end()) return;
+      removeFromCells(i->second);
+      entries[i->second].obj.reset();
+      freeSlots.push_back(i->second);
+      slot.erase(i);
+    }
+
+    /// objects whose box contains (x,y)
+    std::vector<std::shared_ptr<T>> at(float x, float y) const {
+      std::vector<size_t> s(unbounded);
+      auto c=cells.find(key(cell(x),cell(y)));
+      if (c!=cells.end())
+        for (auto i: c->second)
+          if (entries[i].box.contains(x,y))
+            s.push_back(i);
+      return objects(s);
+    }
+
+    /// objects whose box intersects \a b
+    std::vector<std::shared_ptr<T>> in(const SpatialBox& b) const {
+      std::vector<size_t> s(unbounded);
+      long i0=std::max(cx0,cell(b.x0)), i1=std::min(cx1,cell(b.x1)),
+        j0=std::max(cy0,cell(b.y0)), j1=std::min(cy1,cell(b.y1));
+      if (i1<i0 || j1<j0) return objects(s);
+      if (size_t(i1-i0+1)*size_t(j1-j0+1)>cells.size())
+        {
+          // cheaper to scan the occupied cells
+          for (auto& c: cells)
+            for (auto i: c.second)
+              if (entries[i].box.intersects(b))
+                s.push_back(i);
+        }
+      else
+        for (long i=i0; i<=i1; ++i)
+          for (long j=j0; j<=j1; ++j)
+            {
+              auto c=cells.find(key(i,j));
+              if (c!=cells.end())
+                for (auto k: c->second)
+                  if (entries[k].box.intersects(b))
+                    s.push_back(k);
+            }
+      return objects(s);
+    }
+
+    /// calls \a f on objects in order of increasing distance of the
+    /// cells containing them from (x,y), for as long as they may lie
+    /// within \a bound of (x,y). \a f may reduce \a bound.
+    template <class F>
+    void nearest(float x, float y, float& bound, F f) const {
+      for (auto k: unbounded)
+        if (auto o=entries[k].obj.lock())
+          f(o);
+      if (cx1<cx0) return;
+      long ci=cell(x), cj=cell(y);
+      // rings beyond this cannot contain any occupied cell
+      long maxRing=std::max(std::max(ci-cx0, cx1-ci), std::max(cj-cy0, cy1-cj));
+      std::unordered_set<size_t> visited;
+      auto visit=[&](long i, long j) {
+        auto c=cells.find(key(i,j));
+        if (c!=cells.end())
+          for (auto k: c->second)
+            if (visited.insert(k).second && entries[k].box.distance(x,y)<=bound)
+              if (auto o=entries[k].obj.lock())
+                f(o);
+      };
+      long r=std::max(std::max(std::max(cx0-ci, ci-cx1), std::max(cy0-cj, cj-cy1)), 0L);
+      // cells in ring r are at least (r-1)*cellSize from (x,y)
+      for (; r<=maxRing && (r-1)*cellSize<=bound; ++r)
+        for (long i=std::max(ci-r,cx0); i<=std::min(ci+r,cx1); ++i)
+          if (i==ci-r || i==ci+r)
+            for (long j=std::max(cj-r,cy0); j<=std::min(cj+r,cy1); ++j)
+              visit(i,j);
+          else
+            {
+              if (cj-r>=cy0) visit(i,cj-r);
+              if (cj+r<=cy1) visit(i,cj+r);
+            }
+    }
+  };
+
+  /// Spatial index of the items and wires directly contained in a
+  /// group, used for hit testing on the canvas. Items are indexed in
+  /// coordinates local to the group (ie item's m_x, m_y), so are
+  /// unaffected by panning and zooming, or by moving the group
+  /// itself. The item index is built on first use, and thereafter
+  /// updated as items are added, removed, moved or change their
+  /// bounding box. Code positioning items directly, such as
+  /// schema2::Minsky::populateGroup, must invalidate it. I/O
+  /// variables scale with the group's edge, so are tested by every
+  /// query. Wire endpoints may lie in subgroups, so wires are indexed
+  /// in canvas coordinates, and rebuilt when the group is moved or
+  /// zoomed, or any item or attached port below it moves.
+  class SpatialIndex
+  {
+    SpatialGrid<Item> m_items;
+    SpatialGrid<Wire> m_wires;
+    bool itemsValid=false, wiresValid=false;
+    /// group's transform when wires were indexed
+    float wireX=0, wireY=0, wireZoom=0;
+    /// box of item \a i, local to group \a g
+    static SpatialBox box(const Group& g, const Item& i);
+  public:
+    SpatialIndex() {}
+    // index is rebuilt on demand, so need not be copied
+    SpatialIndex(const SpatialIndex&) {}
+    SpatialIndex& operator=(const SpatialIndex&) {return *this;}
+
+    void invalidate() {itemsValid=wiresValid=false;}
+    void invalidateWires() {wiresValid=false;}
+
+    /// @{ maintain the index of item \a i of this group
+    void insert(const std::shared_ptr<Item>& i);
+    void update(const Item& i);
+    void remove(const Item& i);
+    /// @}
+
+    /// @{ queries on the contents of \a g, which must be the group
+    /// owning this index, in canvas coordinates. Results are a
+    /// superset of the objects satisfying the corresponding exact
+    /// test, ordered as in g's containers.
+    
+    /// items whose hit regions (Item::contains) may include (x,y)
+    std::vector<std::shared_ptr<Item>> itemsAt(const Group& g, float x, float y);
+    /// items whose icons may intersect \a b
+    std::vector<std::shared_ptr<Item>> itemsIn(const Group& g, const SpatialBox& b);
+    /// calls \a f on items that may lie within \a bound of (x,y). \a
+    /// f may reduce \a bound.
+    template <class F>
+    void nearestItems(const Group& g, float x, float y, float& bound, F f);
+    /// wires that may be near (x,y), as given by Wire::near
+    std::vector<std::shared_ptr<Wire>> wiresAt(const Group& g, float x, float y);
+    /// wires that may intersect \a b
+    std::vector<std::shared_ptr<Wire>> wiresIn(const Group& g, const SpatialBox& b);
+    /// @}
+
+  private:
+    /// zoom factor and origin of items in \a g
+    static float transform(const Group& g, float& x0, float& y0);
+    void checkItems(const Group& g);
+    void checkWires(const Group& g);
+  };
+
+  template <class F>
+  void SpatialIndex::nearestItems(const Group& g, float x, float y, float& bound, F f)
+  {
+    checkItems(g);
+    float x0, y0, z=transform(g,x0,y0);
+    float localBound=bound/z;
+    m_items.nearest((x-x0)/z, (y-y0)/z, localBound,
+                    [&](const std::shared_ptr<Item>& i) {
+                      f(i);
+                      localBound=bound/z;
+                    });
+  }
+}
+
+#endif
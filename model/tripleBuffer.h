@@ -0,0 +1,63 @@
+/*
+  @copyright Steve Keen 2019
+  @author Russell Standish
+  This file is part of Minsky.
+
+  Minsky is free software: you can redistribute it and/or modify it
+  under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Minsky is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Minsky.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef TRIPLEBUFFER_H
+#define TRIPLEBUFFER_H
+#include <atomic>
+
+namespace minsky
+{
+  /// Lock free exchange of values between a single producer thread
+  /// and a single consumer thread. The producer fills in back(), and
+  /// publishes it. The consumer picks up the most recently published
+  /// value with consume(), and reads it via front(). Neither thread
+  /// ever waits on the other, and values published but not consumed
+  /// before the next publish are dropped.
+  template <class T>
+  class TripleBuffer
+  {
+    T buffers[3];
+    /// index of the buffer in transit between producer and consumer,
+    /// or'ed with the fresh flag if it has been published but not consumed
+    std::atomic<unsigned> middle{1};
+    static constexpr unsigned fresh=4;
+    unsigned backIdx=0, frontIdx=2;
+  public:
+    /// @{ producer side
+    T& back() {return buffers[backIdx];}
+    void publish() {backIdx=middle.exchange(backIdx|fresh) & ~fresh;}
+    /// @}
+
+    /// @{ consumer side
+    /// true if a value has been published since the last consume
+    bool ready() const {return middle.load() & fresh;}
+    /// move the most recently published value to front()
+    /// @return false if nothing new was published
+    bool consume() {
+      if (!ready()) return false;
+      frontIdx=middle.exchange(frontIdx) & ~fresh;
+      return true;
+    }
+    T& front() {return buffers[frontIdx];}
+    const T& front() const {return buffers[frontIdx];}
+    /// @}
+  };
+}
+
+#endif
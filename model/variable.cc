@@ -54,6 +54,11 @@ bool VariableBase::inputWired() const
   return ports.size()>1 && !ports[1]->wires().empty();
 }
 
+bool VariableBase::definesValue() const
+{
+  return inputWired() || (type()==VariableValue::stock && controller.lock());
+}
+
 ClickType::Type VariableBase::clickType(float xx, float yy)
 {
   double fm=std::fmod(rotation,360);
@@ -139,6 +144,17 @@ string VariableBase::_name(const std::string& name)
 bool VariableBase::ioVar() const
 {return dynamic_cast<Group*>(controller.lock().get());}
 
+const string& VariableBase::nameMarkup() const
+{
+  auto n=name();
+  if (n!=m_nameMarkup.name || m_nameMarkup.markup.empty())
+    {
+      m_nameMarkup.markup=latexToPango(n);
+      m_nameMarkup.name=std::move(n);
+    }
+  return m_nameMarkup.markup;
+}
+
 
 void VariableBase::ensureValueExists() const
 {
@@ -377,6 +393,35 @@ bool VariableBase::handleArrows(int dir,bool reset)
 
 
 void VariableBase::draw(cairo_t *cairo) const
+{
+  {
+    // the value and slider are not clipped to the icon outline
+    cairo::CairoSave cs(cairo);
+    drawIcon(cairo);
+  }
+  drawDynamic(cairo);
+  // but callers rely on the outline being left as the clip region
+  cairo_new_path(cairo);
+  iconOutline(cairo);
+  cairo_clip(cairo);
+}
+
+void VariableBase::iconOutline(cairo_t *cairo) const
+{
+  float z=zoomFactor(), w=iconGeometry.w, h=iconGeometry.h;
+  cairo::CairoSave cs(cairo);
+  cairo_rotate(cairo, rotation * M_PI / 180.0);
+  cairo_move_to(cairo,-w,-h);
+  if (lhs())
+    cairo_line_to(cairo,-w+2*z,0);
+  cairo_line_to(cairo,-w,h);
+  cairo_line_to(cairo,w,h);
+  cairo_line_to(cairo,w+2*z,0);
+  cairo_line_to(cairo,w,-h);
+  cairo_close_path(cairo);
+}
+
+void VariableBase::drawIcon(cairo_t *cairo) const
 {
   double angle=rotation * M_PI / 180.0;
   double fm=std::fmod(rotation,360);
@@ -395,40 +440,17 @@ void VariableBase::draw(cairo_t *cairo) const
   w=rv.width()*z; 
   h=rv.height()*z;
   hoffs=rv.top()*z;
+  iconGeometry.w=w;
+  iconGeometry.h=h;
+  iconGeometry.hoffs=hoffs;
+  iconGeometry.sliderWidth=rv.width();
+  iconGeometry.notflipped=notflipped;
 
   cairo_move_to(cairo,r.x(-w+1,-h-hoffs+2), r.y(-w+1,-h-hoffs+2)/*h-2*/);
   rv.show();
 
-  VariableValue vv;
-  if (VariableValue::isValueId(valueId()))
-    vv=minsky::cminsky().variableValues[valueId()];
-  
-  if (type()!=constant && !ioVar() && vv.numElements()==1 )
-    try
-    {
-      auto val=engExp();
-  
-      Pango pangoVal(cairo);
-      pangoVal.setFontSize(6*z);
-      pangoVal.setMarkup(mantissa(val));
-      pangoVal.angle=angle+(notflipped? 0: M_PI);
-
-      cairo_move_to(cairo,r.x(w-pangoVal.width()-2,-h-hoffs+2),
-                    r.y(w-pangoVal.width()-2,-h-hoffs+2));
-      pangoVal.show();
-      if (val.engExp!=0)
-        {
-          pangoVal.setMarkup(expMultiplier(val.engExp));
-          cairo_move_to(cairo,r.x(w-pangoVal.width()-2,0),r.y(w-pangoVal.width()-2,0));
-          pangoVal.show();
-        }
-    }
-    catch (...) {} // ignore errors in obtaining values
-
-  unique_ptr<cairo::Path> clipPath;
   {
     cairo::CairoSave cs(cairo);
-    cairo_rotate(cairo, angle);
     // constants and parameters should be rendered in blue, all others in red
     switch (type())
       {
@@ -439,29 +461,9 @@ void VariableBase::draw(cairo_t *cairo) const
         cairo_set_source_rgb(cairo,1,0,0);
         break;
       }
-    cairo_move_to(cairo,-w,-h);
-    if (lhs())
-      cairo_line_to(cairo,-w+2*z,0);
-    cairo_line_to(cairo,-w,h);
-    cairo_line_to(cairo,w,h);
-    cairo_line_to(cairo,w+2*z,0);
-    cairo_line_to(cairo,w,-h);
-    cairo_close_path(cairo);
-    clipPath.reset(new cairo::Path(cairo));
+    iconOutline(cairo);
     cairo_stroke(cairo);
-    if (type()!=constant && !ioVar())
-      {
-        // draw slider
-        CairoSave cs(cairo);
-        cairo_set_source_rgb(cairo,0,0,0);
-        try
-          {
-            cairo_arc(cairo,(notflipped?1:-1)*z*rv.handlePos(), (notflipped? -h: h), sliderHandleRadius, 0, 2*M_PI);
-          }
-        catch (const error&) {} // handlePos() may throw.
-        cairo_fill(cairo);
-      }
-  }// undo rotation
+  }
 
   double x0=w, y0=0, x1=-w+2, y1=0;
   double sa=sin(angle), ca=cos(angle);
@@ -481,11 +483,60 @@ void VariableBase::draw(cairo_t *cairo) const
     }
 
   cairo_new_path(cairo);
-  clipPath->appendToCurrent(cairo);
+  iconOutline(cairo);
   cairo_clip(cairo);
   if (selected) drawSelected(cairo);
 }
 
+void VariableBase::drawDynamic(cairo_t *cairo) const
+{
+  if (type()==constant || ioVar()) return;
+  double angle=rotation * M_PI / 180.0;
+  float z=zoomFactor();
+  float w=iconGeometry.w, h=iconGeometry.h, hoffs=iconGeometry.hoffs;
+  bool notflipped=iconGeometry.notflipped;
+  Rotate r(rotation + (notflipped? 0: 180),0,0);
+
+  // refer to the value in place, rather than copying tensor data
+  // and axis labels every frame
+  const VariableValue* vv=vValue();
+  if (vv && vv->numElements()==1)
+    try
+    {
+      double v=vv->value();
+      auto val=minsky::engExp(v);
+  
+      Pango pangoVal(cairo);
+      pangoVal.setFontSize(6*z);
+      pangoVal.setMarkup(minsky::mantissa(v,val));
+      pangoVal.angle=angle+(notflipped? 0: M_PI);
+
+      cairo_move_to(cairo,r.x(w-pangoVal.width()-2,-h-hoffs+2),
+                    r.y(w-pangoVal.width()-2,-h-hoffs+2));
+      pangoVal.show();
+      if (val.engExp!=0)
+        {
+          pangoVal.setMarkup(expMultiplier(val.engExp));
+          cairo_move_to(cairo,r.x(w-pangoVal.width()-2,0),r.y(w-pangoVal.width()-2,0));
+          pangoVal.show();
+        }
+    }
+    catch (...) {} // ignore errors in obtaining values
+
+  // draw slider
+  CairoSave cs(cairo);
+  cairo_new_path(cairo);
+  cairo_rotate(cairo, angle);
+  cairo_set_source_rgb(cairo,0,0,0);
+  try
+    {
+      double handlePos=RenderVariable::handlePos(*this, iconGeometry.sliderWidth);
+      cairo_arc(cairo,(notflipped?1:-1)*z*handlePos, (notflipped? -h: h), sliderHandleRadius, 0, 2*M_PI);
+    }
+  catch (const error&) {} // value() may throw.
+  cairo_fill(cairo);
+}
+
 void VariablePtr::makeConsistentWithValue()
 {
   retype(minsky::cminsky().variableValues[get()->valueId()].type());
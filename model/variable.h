@@ -72,6 +72,22 @@ namespace minsky
     std::string m_name; 
     mutable int unitsCtr=0; ///< for detecting reentrancy in units()
     static int stockVarsPassed; ///< for detecting reentrancy in units()
+    /// icon dimensions computed by drawIcon(), for use by drawDynamic()
+    struct IconGeometry
+    {
+      float w=0, h=0, hoffs=0, sliderWidth=0;
+      bool notflipped=true;
+    };
+    mutable classdesc::Exclude<IconGeometry> iconGeometry;
+    /// adds the icon's outline, as last drawn by drawIcon(), to the
+    /// current path
+    void iconOutline(cairo_t*) const;
+    /// name and its Pango markup, as returned by nameMarkup()
+    struct NameMarkup
+    {
+      std::string name, markup;
+    };
+    mutable classdesc::Exclude<NameMarkup> m_nameMarkup;
 
   protected:
     void addPorts();
@@ -105,6 +121,9 @@ namespace minsky
     /// accessor for the name member (may differ from name() with top
     /// level variables)
     const std::string& rawName() const {return m_name;}
+    /// name() converted to Pango markup, which is remembered until
+    /// the name changes
+    const std::string& nameMarkup() const;
     
     bool ioVar() const override;
     
@@ -180,9 +199,18 @@ namespace minsky
         @return cairo path of icon outline
     */
     void draw(cairo_t*) const override;
+    /// drawIcon() draws the name and outline, and drawDynamic() the
+    /// current value and slider. I/O variables also depend on their
+    /// group's focus, so are not cached.
+    bool iconCacheable() const override {return !ioVar();}
+    void drawIcon(cairo_t*) const override;
+    void drawDynamic(cairo_t*) const override;
     ClickType::Type clickType(float x, float y) override;
     
     bool inputWired() const;
+    /// true if this variable supplies the definition of its value,
+    /// either via a wired input, or as a Godley table stock
+    bool definesValue() const;
     /// return a list of existing variables a variable in this group
     /// could be connected to
     std::vector<std::string> accessibleVars() const;
@@ -31,28 +31,68 @@ extern "C" int TkMakeBezierCurve(Tk_Canvas,double*,int,int,void*,double*);
 
 namespace minsky
 {
+  const Wire::Geometry& Wire::geometry() const
+  {
+    Geometry& g=m_geometry;
+    auto f=from(), t=to();
+    if (!f || !t)
+      {
+        g=Geometry();
+        return g;
+      }
+    float fx=f->x(), fy=f->y(), tx=t->x(), ty=t->y();
+    if (!g.coords.empty() && fx==g.fromX && fy==g.fromY && tx==g.toX && ty==g.toY &&
+        g.controlPoints==m_coords)
+      return g;
+
+    g.fromX=fx; g.fromY=fy; g.toX=tx; g.toY=ty;
+    g.controlPoints=m_coords;
+    auto& c=g.coords;
+    c.clear();
+    c.push_back(fx);
+    c.push_back(fy);
+    float d=sqrt(sqr(fx-tx)+sqr(fy-ty));
+    for (size_t i=0; m_coords.size()>1 && i<m_coords.size()-1; i+=2)
+      {
+        c.push_back(fx + d*m_coords[i]);
+        c.push_back(fy + d*m_coords[i+1]);
+      }
+    c.push_back(tx);
+    c.push_back(ty);
+
+    g.curve.clear();
+    if (c.size()==4)
+      {
+        g.angle=atan2(c[3]-c[1], c[2]-c[0]);
+        g.endX=c[2]; g.endY=c[3];
+      }
+    else
+      {
+        // need to convert to double precision for Tk
+        vector<double> dcoords(c.begin(), c.end());
+        // Use Tk's smoothing algorithm for computing curves
+        const int numSteps=100;
+        // Tk's documentation doesn't say how big this buffer should
+        // be, hopefully this is ample.
+        g.curve.resize(2*numSteps*(dcoords.size()+1));
+        // TODO - find a way of doing this that doesn't involve Tk!
+        int numPoints=
+          TkMakeBezierCurve(0,dcoords.data(),dcoords.size()/2,numSteps,
+                            nullptr,g.curve.data());
+        g.curve.resize(2*numPoints);
+        auto& p=g.curve;
+        g.angle=atan2(p[2*numPoints-1]-p[2*numPoints-3], 
+                      p[2*numPoints-2]-p[2*numPoints-4]);
+        g.endX=p[2*numPoints-2]; g.endY=p[2*numPoints-1];
+      }
+    return g;
+  }
+
   vector<float> Wire::_coords() const
   {
-    vector<float> c;
     assert(from() && to());
     assert(m_coords.size() % 2 == 0);
-    if (auto f=from())
-      if (auto t=to())
-        {
-          c.push_back(f->x());
-          c.push_back(f->y());
-          float d=sqrt
-            (sqr(f->x()-t->x())+sqr(f->y()-t->y()));
-
-          for (size_t i=0; m_coords.size()>1 && i<m_coords.size()-1; i+=2)
-            {
-              c.push_back(f->x() + d*m_coords[i]);
-              c.push_back(f->y() + d*m_coords[i+1]);
-            }
-          c.push_back(t->x());
-          c.push_back(t->y());
-        }
-    return c;
+    return geometry().coords;
   }
 
   vector<float> Wire::_coords(const vector<float>& coords)
@@ -139,69 +179,71 @@ namespace minsky
 
   void Wire::draw(cairo_t* cairo) const
   {
-    auto coords=this->coords();
-    if (coords.size()<4 || !visible()) return;
+    if (geometry().coords.size()<4 || !visible()) return;
+    addPath(cairo);
+    cairo_stroke(cairo);
+    addArrowhead(cairo);
+    cairo_fill(cairo);
+    if (mouseFocus)
+      drawHandles(cairo);
+  }
 
-    double angle, lastx, lasty;
-    if (coords.size()==4)
+  void Wire::addPath(cairo_t* cairo) const
+  {
+    auto& g=geometry();
+    if (g.coords.size()<4) return;
+    if (g.curve.empty())
       {
-        cairo_move_to(cairo,coords[0],coords[1]);
-        cairo_line_to(cairo, coords[2], coords[3]);
-        angle=atan2(coords[3]-coords[1], coords[2]-coords[0]);
-        lastx=coords[2]; lasty=coords[3];
+        cairo_move_to(cairo,g.coords[0],g.coords[1]);
+        cairo_line_to(cairo,g.coords[2],g.coords[3]);
       }
     else
       {
-        // need to convert to double precision for Tk
-        vector<double> dcoords(coords.begin(), coords.end());
-        // Use Tk's smoothing algorithm for computing curves
-        const int numSteps=100;
-        // Tk's documentation doesn't say how big this buffer should
-        // be, hopefully this is ample.
-        vector<double> points(2*numSteps*(dcoords.size()+1));
-        // TODO - find a way of doing this that doesn't involve Tk!
-        int numPoints=
-          TkMakeBezierCurve(0,dcoords.data(),dcoords.size()/2,numSteps,
-                            nullptr,points.data());
-        
-        cairo_move_to(cairo, points[0], points[1]);
-        for (int i=2; i<2*numPoints; i+=2)
-          cairo_line_to(cairo, points[i], points[i+1]);
-        cairo_stroke(cairo);
-        angle=atan2(points[2*numPoints-1]-points[2*numPoints-3], 
-                    points[2*numPoints-2]-points[2*numPoints-4]);
-        lastx=points[2*numPoints-2]; lasty=points[2*numPoints-1];
+        cairo_move_to(cairo,g.curve[0],g.curve[1]);
+        for (size_t i=2; i<g.curve.size()-1; i+=2)
+          cairo_line_to(cairo,g.curve[i],g.curve[i+1]);
       }
-    cairo_stroke(cairo);
+  }
 
-    // draw arrow
-    cairo_save(cairo);
-    cairo_translate(cairo, lastx, lasty);
-    cairo_rotate(cairo,angle);
-    cairo_move_to(cairo,0,0);
-    cairo_line_to(cairo,-5,-3); 
-    cairo_line_to(cairo,-3,0); 
-    cairo_line_to(cairo,-5,3);
+  void Wire::addArrowhead(cairo_t* cairo) const
+  {
+    auto& g=geometry();
+    if (g.coords.size()<4) return;
+    double c=cos(g.angle), s=sin(g.angle);
+    auto lineTo=[&](double x, double y)
+      {cairo_line_to(cairo, g.endX+c*x-s*y, g.endY+s*x+c*y);};
+    cairo_move_to(cairo,g.endX,g.endY);
+    lineTo(-5,-3); 
+    lineTo(-3,0); 
+    lineTo(-5,3);
     cairo_close_path(cairo);
-    cairo_fill(cairo);
-    cairo_restore(cairo);
+  }
 
-    // draw handles
-    if (mouseFocus)
+  void Wire::drawHandles(cairo_t* cairo) const
+  {
+    auto& coords=geometry().coords;
+    if (coords.size()<4) return;
+    cairo_save(cairo);
+    cairo_set_source_rgb(cairo,0,0,1);
+    for (size_t i=0; i<coords.size()-3; i+=2)
       {
-        cairo_save(cairo);
-        cairo_set_source_rgb(cairo,0,0,1);
-        for (size_t i=0; i<coords.size()-3; i+=2)
-          {
-            double midx=0.5*(coords[i]+coords[i+2]);
-            double midy=0.5*(coords[i+1]+coords[i+3]);
-            cairo_arc(cairo,midx,midy,handleRadius, 0, 2*M_PI);
-            if (i>0) // draw existing interor handle
-              cairo_arc(cairo,coords[i],coords[i+1],handleRadius, 0, 2*M_PI);
-            cairo_fill(cairo);
-          }
-        cairo_restore(cairo);
+        double midx=0.5*(coords[i]+coords[i+2]);
+        double midy=0.5*(coords[i+1]+coords[i+3]);
+        cairo_arc(cairo,midx,midy,handleRadius, 0, 2*M_PI);
+        if (i>0) // draw existing interor handle
+          cairo_arc(cairo,coords[i],coords[i+1],handleRadius, 0, 2*M_PI);
+        cairo_fill(cairo);
       }
+    cairo_restore(cairo);
+  }
+
+  void Wire::drawSimplified(cairo_t* cairo) const
+  {
+    auto& coords=geometry().coords;
+    if (coords.size()<4) return;
+    cairo_move_to(cairo,coords[0],coords[1]);
+    for (size_t i=2; i<coords.size()-1; i+=2)
+      cairo_line_to(cairo,coords[i],coords[i+1]);
   }
 
   void Wire::split()
@@ -275,7 +317,7 @@ namespace minsky
   
   bool Wire::near(float x, float y) const
   {
-    auto c=coords();
+    auto& c=geometry().coords;
     assert(c.size()>=4);
     if (c.size()==4)
       return segNear(c[0],c[1],c[2],c[3],x,y);
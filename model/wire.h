@@ -48,6 +48,21 @@ namespace minsky
 
     constexpr static float handleRadius=3;
     mutable int unitsCtr=0; ///< for detecting wiring loops in units()
+
+    /// display geometry, computed from the port positions and control
+    /// points it was last computed for
+    struct Geometry
+    {
+      float fromX=0, fromY=0, toX=0, toY=0;
+      std::vector<float> controlPoints; ///< m_coords
+      std::vector<float> coords; ///< as returned by coords()
+      std::vector<double> curve; ///< smoothed path of curved wires
+      double angle=0, endX=0, endY=0; ///< direction and tip of arrowhead
+    };
+    mutable classdesc::Exclude<Geometry> m_geometry;
+    /// returns display geometry, recomputing it if either port has
+    /// moved, or the control points have changed
+    const Geometry& geometry() const;
   public:
 
     Wire() {}
@@ -64,6 +79,19 @@ namespace minsky
     void moveToPorts(const std::shared_ptr<Port>& from, const std::shared_ptr<Port>& to);
     /// draw this item into a cairo context
     void draw(cairo_t* cairo) const;
+    /// @{ components of draw(), allowing the canvas to stroke or fill
+    /// many wires in a single operation
+    /// adds the wire's line to the current path
+    void addPath(cairo_t* cairo) const;
+    /// adds the wire's arrowhead to the current path
+    void addArrowhead(cairo_t* cairo) const;
+    /// draw handles for editing control points
+    void drawHandles(cairo_t* cairo) const;
+    /// @}
+    /// adds a polyline through the wire's control points to the
+    /// current path, without arrowhead or handles, for rendering
+    /// wires between items drawn simplified
+    void drawSimplified(cairo_t* cairo) const;
     
     /// display coordinates 
     std::vector<float> _coords() const;
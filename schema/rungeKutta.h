@@ -28,6 +28,11 @@ namespace minsky
     double epsRel{1e-2}, epsAbs{1e-3};
     int order{4};
     bool implicit{false};
+    /// explicit integration method. gslIntegrator selects GSL's
+    /// solvers according to \a order, the others are built in, and
+    /// do not depend on order. Implicit solvers always use GSL.
+    enum Integrator {gslIntegrator, rk4, dormandPrince54, lowStorageRK4};
+    Integrator integrator{gslIntegrator};
     int simulationDelay{0};
     std::string timeUnit;
   };
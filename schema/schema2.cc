@@ -274,10 +274,39 @@ namespace schema2
     };
  }
   
+  namespace
+  {
+    /// tensor data as read from a file, decoded on first use
+    struct TensorData: public minsky::DeferredTensorInit
+    {
+      CDATA data;
+      TensorData(const CDATA& data): data(data) {}
+      void decode(minsky::TensorVal& tensorInit, vector<minsky::XVector>& xVector) const override
+      {
+        string trimmed; //trim whitespace
+        for (auto c: data)
+          if (!isspace(c)) trimmed+=c;
+
+        vector<unsigned char> zbuf(a85::size_for_bin(trimmed.size()));
+        // reverse transformation required to avoid the escape sequence ']]>'
+        replace(trimmed.begin(),trimmed.end(),'~',']'); 
+        a85::from_a85(trimmed.data(), trimmed.size(),zbuf.data());
+              
+        InflateZStream zs(zbuf);
+        zs.inflate();
+              
+        zs.output>>tensorInit>>xVector;
+      }
+    };
+  }
+  
   void Item::packTensorInit(const minsky::VariableBase& v)
   {
     if (auto val=v.vValue())
-      if (!val->tensorInit.data.empty())
+      if (auto d=dynamic_cast<const TensorData*>(val->deferredTensorInit.get()))
+        // data unchanged since loaded, so no need to reencode it
+        tensorData.reset(new CDATA(d->data));
+      else if (!val->tensorInit.data.empty())
         {
           pack_t buf;
           buf<<val->tensorInit<<val->xVector;
@@ -487,25 +516,9 @@ namespace schema2
         if (y.tensorData)
           if (auto val=x1->vValue())
             {
-              string trimmed; //trim whitespace
-              for (auto c: *y.tensorData)
-                if (!isspace(c)) trimmed+=c;
-
-              vector<unsigned char> zbuf(a85::size_for_bin(trimmed.size()));
-              // reverse transformation required to avoid the escape sequence ']]>'
-              replace(trimmed.begin(),trimmed.end(),'~',']'); 
-              a85::from_a85(trimmed.data(), trimmed.size(),zbuf.data());
-              
-              InflateZStream zs(zbuf);
-              zs.inflate();
-              
-              vector<minsky::XVector> xv;
-              try
-                {
-                  zs.output>>val->tensorInit>>xv;
-                  val->setXVector(xv);
-                }
-              catch (...) {} // absorb for now - maybe log later
+              // decoding is deferred until the data is actually needed
+              val->tensorInit=minsky::TensorVal();
+              val->deferredTensorInit.reset(new TensorData(*y.tensorData));
             }
       }
     if (auto x1=dynamic_cast<minsky::OperationBase*>(&x))
@@ -713,6 +726,8 @@ namespace schema2
                 }
           }
       }
+    // populateItem sets positions directly, bypassing index updates
+    g.invalidateSpatialIndices();
   }
 }
 
@@ -17,9 +17,13 @@
   along with Minsky.  If not, see <http://www.gnu.org/licenses/>.
 */
 #include "minsky.h"
+#include "simulationLog.h"
+#include "sensitivity.h"
 #include <ecolab_epilogue.h>
 #include <UnitTest++/UnitTest++.h>
 #include <gsl/gsl_integration.h>
+#include <fstream>
+#include <regex>
 using namespace minsky;
 
 namespace
@@ -33,6 +37,37 @@ namespace
   };
 }
 
+namespace
+{
+  /// provides a clipboard, which TestFixture lacks
+  struct ClipboardFixture: public TestFixture
+  {
+    mutable std::string clipboard;
+    void putClipboard(const string& x) const override {clipboard=x;}
+    std::string getClipboard() const override {return clipboard;}
+
+    /// check \a g contains a copy of variables a and b wired together
+    void checkCopy(const Group& g)
+    {
+      CHECK_EQUAL(2, g.items.size());
+      CHECK_EQUAL(1, g.wires.size());
+      if (g.wires.size()!=1) return;
+      auto& w=*g.wires[0];
+      auto from=w.from()->item.variableCast(), to=w.to()->item.variableCast();
+      CHECK(from && to);
+      if (!from || !to) return;
+      CHECK_EQUAL("a", from->name());
+      CHECK_EQUAL("b", to->name());
+      // wire connects the copies, not the originals
+      for (auto& i: model->items)
+        {
+          CHECK(&w.from()->item!=i.get());
+          CHECK(&w.to()->item!=i.get());
+        }
+    }
+  };
+}
+
 SUITE(Minsky)
 {
   /*
@@ -334,6 +369,544 @@ SUITE(Minsky)
       CHECK_CLOSE(0.5*value*t*t, intOp->intVar->value(), 1e-5);
     }
 
+  TEST_FIXTURE(TestFixture,sparseImplicitSolver)
+    {
+      // integrate a linear function with the sparse Rosenbrock solver
+      auto op1=model->addItem(new VarConstant);
+      auto op2=model->addItem(OperationPtr(OperationBase::integrate));
+      auto op3=model->addItem(OperationPtr(OperationBase::integrate));
+      model->addWire(*op1,*op2,1,vector<float>());
+      model->addWire(*op2,*op3,1,vector<float>());
+      double value = 10;
+      dynamic_cast<VariableBase*>(op1.get())->init(to_string(value));
+      IntOp* intOp=dynamic_cast<IntOp*>(op3.get());
+      CHECK(intOp);
+
+      implicit=true;
+      order=2;
+      nSteps=10;
+      reset();
+      step();
+      CHECK(t>0);
+      CHECK_CLOSE(0.5*value*t*t, intOp->intVar->value(), 1e-5);
+    }
+
+  TEST_FIXTURE(TestFixture,stiffImplicitSolver)
+    {
+      // dx/dt=k(y-x), dy/dt=-y, with eigenvalues -k and -1
+      const double k=1000;
+      auto kc=model->addItem(new VarConstant);
+      dynamic_cast<VariableBase*>(kc.get())->init(to_string(k));
+      auto m1=model->addItem(new VarConstant);
+      dynamic_cast<VariableBase*>(m1.get())->init("-1");
+      auto intX=model->addItem(OperationPtr(OperationBase::integrate));
+      auto intY=model->addItem(OperationPtr(OperationBase::integrate));
+      auto sub=model->addItem(OperationPtr(OperationBase::subtract));
+      auto mulX=model->addItem(OperationPtr(OperationBase::multiply));
+      auto mulY=model->addItem(OperationPtr(OperationBase::multiply));
+      model->addWire(*intY,*sub,1,vector<float>());
+      model->addWire(*intX,*sub,2,vector<float>());
+      model->addWire(*kc,*mulX,1,vector<float>());
+      model->addWire(*sub,*mulX,2,vector<float>());
+      model->addWire(*mulX,*intX,1,vector<float>());
+      model->addWire(*m1,*mulY,1,vector<float>());
+      model->addWire(*intY,*mulY,2,vector<float>());
+      model->addWire(*mulY,*intY,1,vector<float>());
+      IntOp* x=dynamic_cast<IntOp*>(intX.get());
+      IntOp* y=dynamic_cast<IntOp*>(intY.get());
+      CHECK(x && y);
+      y->intVar->init("1");
+
+      stepMax=0.1;
+      epsAbs=epsRel=1e-4;
+      auto stepsTo1=[&]() {
+        nSteps=1;
+        reset();
+        int steps=0;
+        for (; t<1 && steps<5000; ++steps)
+          step();
+        return steps;
+      };
+
+      implicit=true;
+      order=2;
+      reset();
+      runUntil(1);
+      CHECK_CLOSE(exp(-1), y->intVar->value(), 1e-3);
+      CHECK_CLOSE(k/(k-1)*(exp(-1)-exp(-k)), x->intVar->value(), 1e-3);
+      int implicitSteps=stepsTo1();
+
+      // an explicit solver's step size is limited by stability to
+      // about 2/k once the fast transient has decayed
+      implicit=false;
+      int explicitSteps=stepsTo1();
+      CHECK(implicitSteps<200);
+      CHECK(2*implicitSteps<explicitSteps);
+    }
+
+  TEST_FIXTURE(TestFixture,nativeIntegrators)
+    {
+      // integrate a linear function with each built in integrator
+      auto op1=model->addItem(new VarConstant);
+      auto op2=model->addItem(OperationPtr(OperationBase::integrate));
+      auto op3=model->addItem(OperationPtr(OperationBase::integrate));
+      model->addWire(*op1,*op2,1,vector<float>());
+      model->addWire(*op2,*op3,1,vector<float>());
+      double value = 10;
+      dynamic_cast<VariableBase*>(op1.get())->init(to_string(value));
+      IntOp* intOp=dynamic_cast<IntOp*>(op3.get());
+      CHECK(intOp);
+
+      nSteps=10;
+      for (auto i: {rk4, dormandPrince54, lowStorageRK4})
+        {
+          integrator=i;
+          reset();
+          step();
+          CHECK(t>0);
+          CHECK_CLOSE(0.5*value*t*t, intOp->intVar->value(), 1e-5);
+        }
+    }
+
+  TEST_FIXTURE(TestFixture,integratorOrder)
+    {
+      // logistic equation dx/dt=x(1-x), so x=1/(1+9exp(-t)) for x(0)=0.1
+      auto one=model->addItem(new VarConstant);
+      dynamic_cast<VariableBase*>(one.get())->init("1");
+      auto sub=model->addItem(OperationPtr(OperationBase::subtract));
+      auto mul=model->addItem(OperationPtr(OperationBase::multiply));
+      auto integ=model->addItem(OperationPtr(OperationBase::integrate));
+      model->addWire(*one,*sub,1,vector<float>());
+      model->addWire(*integ,*sub,2,vector<float>());
+      model->addWire(*integ,*mul,1,vector<float>());
+      model->addWire(*sub,*mul,2,vector<float>());
+      model->addWire(*mul,*integ,1,vector<float>());
+      IntOp* intOp=dynamic_cast<IntOp*>(integ.get());
+      CHECK(intOp);
+      intOp->intVar->init("0.1");
+
+      // tolerances loose enough that Dormand-Prince always takes steps of stepMax
+      epsAbs=epsRel=1e10;
+      auto globalError=[&](double h) {
+        stepMax=h;
+        reset();
+        runUntil(2);
+        return fabs(intOp->intVar->value()-1/(1+9*exp(-2)));
+      };
+      // halving the step size divides the error by 2^order
+      for (auto i: {rk4, lowStorageRK4, dormandPrince54})
+        {
+          integrator=i;
+          double order=log2(globalError(0.2)/globalError(0.1));
+          CHECK_CLOSE(i==dormandPrince54? 5.0: 4.0, order, 0.5);
+        }
+    }
+
+  TEST_FIXTURE(TestFixture,loadWithoutIntegrator)
+    {
+      // files written before the integrator field was added still load
+      model->addItem(VariablePtr(VariableType::parameter,"a"));
+      integrator=rk4;
+      save("loadWithoutIntegrator.mky");
+      string xml;
+      {
+        ifstream f("loadWithoutIntegrator.mky");
+        xml.assign(istreambuf_iterator<char>(f), istreambuf_iterator<char>());
+      }
+      regex integratorElem("<integrator>[^<]*</integrator>");
+      CHECK(regex_search(xml, integratorElem));
+      ofstream("loadWithoutIntegrator.mky")<<regex_replace(xml, integratorElem, "");
+
+      Minsky m;
+      m.integrator=lowStorageRK4;
+      m.load("loadWithoutIntegrator.mky");
+      CHECK_EQUAL(gslIntegrator, m.integrator);
+      CHECK_EQUAL(1, m.model->numItems());
+    }
+
+  TEST_FIXTURE(TestFixture,steadyState)
+    {
+      // dx/dt=value-x², with a singular Jacobian at x=0
+      auto c=model->addItem(new VarConstant);
+      auto sub=model->addItem(OperationPtr(OperationBase::subtract));
+      auto mul=model->addItem(OperationPtr(OperationBase::multiply));
+      auto integ=model->addItem(OperationPtr(OperationBase::integrate));
+      model->addWire(*c,*sub,1,vector<float>());
+      model->addWire(*integ,*mul,1,vector<float>());
+      model->addWire(*integ,*mul,2,vector<float>());
+      model->addWire(*mul,*sub,2,vector<float>());
+      model->addWire(*sub,*integ,1,vector<float>());
+      double value = 10;
+      dynamic_cast<VariableBase*>(c.get())->init(to_string(value));
+      IntOp* intOp=dynamic_cast<IntOp*>(integ.get());
+      CHECK(intOp);
+
+      reset();
+      CHECK(findSteadyState()>0);
+      CHECK_CLOSE(sqrt(value), intOp->intVar->value(), 1e-6);
+      // already at the steady state
+      CHECK_EQUAL(0u, findSteadyState());
+    }
+
+  TEST_FIXTURE(TestFixture,steadyStateSparsity)
+    {
+      // dx/dt=4-y², dy/dt=x-y, starting from x=y=0, where the
+      // Jacobian entry ∂ẋ/∂y is zero, so is missed from the sparsity
+      // pattern, and the Jacobian is singular
+      auto c=model->addItem(new VarConstant);
+      dynamic_cast<VariableBase*>(c.get())->init("4");
+      auto sub1=model->addItem(OperationPtr(OperationBase::subtract));
+      auto sub2=model->addItem(OperationPtr(OperationBase::subtract));
+      auto mul=model->addItem(OperationPtr(OperationBase::multiply));
+      auto intX=model->addItem(OperationPtr(OperationBase::integrate));
+      auto intY=model->addItem(OperationPtr(OperationBase::integrate));
+      model->addWire(*intY,*mul,1,vector<float>());
+      model->addWire(*intY,*mul,2,vector<float>());
+      model->addWire(*c,*sub1,1,vector<float>());
+      model->addWire(*mul,*sub1,2,vector<float>());
+      model->addWire(*sub1,*intX,1,vector<float>());
+      model->addWire(*intX,*sub2,1,vector<float>());
+      model->addWire(*intY,*sub2,2,vector<float>());
+      model->addWire(*sub2,*intY,1,vector<float>());
+      IntOp* x=dynamic_cast<IntOp*>(intX.get());
+      IntOp* y=dynamic_cast<IntOp*>(intY.get());
+      CHECK(x && y);
+
+      reset();
+      CHECK(findSteadyState()>0);
+      CHECK_CLOSE(2, x->intVar->value(), 1e-6);
+      CHECK_CLOSE(2, y->intVar->value(), 1e-6);
+    }
+
+  TEST_FIXTURE(TestFixture,sensitivity)
+    {
+      // dx/dt=a x, so x=x0 exp(at), dx/da=t x and dx/dx0=exp(at)
+      VariablePtr a(VariableType::parameter,"a");
+      a->init("0.5");
+      model->addItem(a);
+      auto mul=model->addItem(OperationPtr(OperationBase::multiply));
+      auto integ=model->addItem(OperationPtr(OperationBase::integrate));
+      model->addWire(*a,*mul,1,vector<float>());
+      model->addWire(*integ,*mul,2,vector<float>());
+      model->addWire(*mul,*integ,1,vector<float>());
+      IntOp* intOp=dynamic_cast<IntOp*>(integ.get());
+      CHECK(intOp);
+      intOp->intVar->init("2");
+
+      epsRel=epsAbs=1e-8;
+      reset();
+      SensitivityAnalysis sa(*this, {a->valueId(), intOp->intVar->valueId()},
+                             {intOp->intVar->valueId()});
+      sa.runUntil(1);
+      CHECK_CLOSE(1, t, 1e-10);
+      double x=2*exp(0.5);
+      CHECK_CLOSE(x, sa.values()[0], 1e-5);
+      auto g=sa.gradients();
+      CHECK_CLOSE(x, g[0][0], 1e-5);
+      CHECK_CLOSE(exp(0.5), g[0][1], 1e-5);
+    }
+
+  TEST_FIXTURE(TestFixture,runUntil)
+    {
+      // dx/dt=a x, so x=x0 exp(at)
+      VariablePtr a(VariableType::parameter,"a");
+      a->init("0.5");
+      model->addItem(a);
+      auto mul=model->addItem(OperationPtr(OperationBase::multiply));
+      auto integ=model->addItem(OperationPtr(OperationBase::integrate));
+      model->addWire(*a,*mul,1,vector<float>());
+      model->addWire(*integ,*mul,2,vector<float>());
+      model->addWire(*mul,*integ,1,vector<float>());
+      IntOp* intOp=dynamic_cast<IntOp*>(integ.get());
+      CHECK(intOp);
+      intOp->intVar->init("2");
+
+      epsRel=epsAbs=1e-10;
+      reset();
+      runUntil(1);
+      CHECK_CLOSE(1, t, 1e-10);
+      CHECK_CLOSE(2*exp(0.5), intOp->intVar->value(), 1e-6);
+      // flow variables are brought up to date
+      CHECK_CLOSE(exp(0.5), mul->ports[0]->getVariableValue().value(), 1e-6);
+      CHECK_THROW(runUntil(0.5), std::exception);
+
+      // the same result is obtained in several pieces
+      reset();
+      for (int i=1; i<=10; ++i)
+        {
+          runUntil(0.1*i);
+          CHECK_CLOSE(2*exp(0.05*i), intOp->intVar->value(), 1e-6);
+        }
+
+      // explicit Euler, which takes unit steps, as step() does
+      order=1;
+      implicit=false;
+      stepMax=1;
+      reset();
+      runUntil(2);
+      CHECK_CLOSE(2, t, 1e-10);
+      CHECK_CLOSE(2*1.5*1.5, intOp->intVar->value(), 1e-10);
+
+      reverse=true;
+      CHECK_THROW(runUntil(2), std::exception);
+    }
+
+  TEST_FIXTURE(TestFixture,simulationThread)
+    {
+      // dx/dt=a x + t, integrated by step() on the simulation thread,
+      // and by runUntil() on this one
+      VariablePtr a(VariableType::parameter,"a");
+      a->init("0.5");
+      model->addItem(a);
+      auto mul=model->addItem(OperationPtr(OperationBase::multiply));
+      auto timeOp=model->addItem(OperationPtr(OperationBase::time));
+      auto add=model->addItem(OperationPtr(OperationBase::add));
+      auto integ=model->addItem(OperationPtr(OperationBase::integrate));
+      model->addWire(*a,*mul,1,vector<float>());
+      model->addWire(*integ,*mul,2,vector<float>());
+      model->addWire(*mul,*add,1,vector<float>());
+      model->addWire(*timeOp,*add,2,vector<float>());
+      model->addWire(*add,*integ,1,vector<float>());
+      IntOp* intOp=dynamic_cast<IntOp*>(integ.get());
+      CHECK(intOp);
+      intOp->intVar->init("2");
+
+      // fixed step size, so that both take the same steps
+      integrator=rk4;
+      stepMax=0.01;
+      nSteps=10;
+      auto synchronous=[&](double tEnd) {
+        reset();
+        runUntil(tEnd);
+        return intOp->intVar->value();
+      };
+
+      reset();
+      for (int i=0; i<10; ++i)
+        step();
+      CHECK_CLOSE(1, t, 1e-10);
+      double x=intOp->intVar->value();
+      // flow variables are those of the state returned
+      CHECK_CLOSE(0.5*x+t, add->ports[0]->getVariableValue().value(), 1e-10);
+      CHECK_CLOSE(synchronous(1), x, 1e-10);
+
+      // decoupled, the worker runs ahead of the results picked up
+      decoupledSimulation=true;
+      reset();
+      for (int i=0; t<1 && i<100000; ++i)
+        step();
+      pauseSimulationThread();
+      running=false;
+      double tEnd=t;
+      x=intOp->intVar->value();
+      CHECK(tEnd>=1);
+      CHECK_CLOSE(0.5*x+tEnd, add->ports[0]->getVariableValue().value(), 1e-10);
+      CHECK_CLOSE(synchronous(tEnd), x, 1e-10);
+    }
+
+  TEST_FIXTURE(TestFixture,eventDetection)
+    {
+      // dx/dt=x<1, so x=min(t,1)
+      auto one=model->addItem(new VarConstant);
+      auto lt=model->addItem(OperationPtr(OperationBase::lt));
+      auto integ=model->addItem(OperationPtr(OperationBase::integrate));
+      dynamic_cast<VariableBase*>(one.get())->init("1");
+      model->addWire(*integ,*lt,1,vector<float>());
+      model->addWire(*one,*lt,2,vector<float>());
+      model->addWire(*lt,*integ,1,vector<float>());
+      IntOp* intOp=dynamic_cast<IntOp*>(integ.get());
+      CHECK(intOp);
+
+      stepMax=1;
+      epsAbs=epsRel=1e-8;
+      reset();
+      CHECK_EQUAL(1u, discontinuities.size());
+      runUntil(0.5);
+      CHECK_CLOSE(0.5, intOp->intVar->value(), 1e-6);
+      runUntil(2);
+      CHECK_CLOSE(1, intOp->intVar->value(), 1e-6);
+    }
+
+  TEST_FIXTURE(TestFixture,liveParameterUpdate)
+    {
+      // dx/dt=a, with a changed from 1 to 2 at t=1
+      VariablePtr a(VariableType::parameter,"a");
+      a->init("1");
+      model->addItem(a);
+      auto integ=model->addItem(OperationPtr(OperationBase::integrate));
+      model->addWire(*a,*integ,1,vector<float>());
+      IntOp* intOp=dynamic_cast<IntOp*>(integ.get());
+      CHECK(intOp);
+
+      reset();
+      runUntil(1);
+      CHECK_CLOSE(1, intOp->intVar->value(), 1e-6);
+
+      a->init("2");
+      CHECK(!structureChanged());
+      markParametersEdited();
+      CHECK(!reset_flag());
+      CHECK_CLOSE(1, t, 1e-10);
+      CHECK_EQUAL(2, a->value());
+      runUntil(2);
+      CHECK_CLOSE(3, intOp->intVar->value(), 1e-6);
+
+      // a change in structure still requires a reset
+      a->init("iota(3)");
+      CHECK(structureChanged());
+    }
+
+  TEST_FIXTURE(TestFixture,parameterEditsFromHistory)
+    {
+      // dx/dt=a
+      VariablePtr a(VariableType::parameter,"a");
+      a->init("1");
+      model->addItem(a);
+      auto integ=model->addItem(OperationPtr(OperationBase::integrate));
+      model->addWire(*a,*integ,1,vector<float>());
+      IntOp* intOp=dynamic_cast<IntOp*>(integ.get());
+      CHECK(intOp);
+
+      clearHistory();
+      CHECK(historyStructureChanged());
+      pushHistory();
+      reset();
+      CHECK(!historyStructureChanged());
+
+      // a parameter value change is classified from the recorded history
+      a->init("2");
+      CHECK(pushHistory());
+      CHECK(!historyStructureChanged());
+      // as is a change of layout
+      a->moveTo(100,100);
+      CHECK(pushHistory());
+      CHECK(!historyStructureChanged());
+      model->addItem(OperationPtr(OperationBase::time));
+      CHECK(pushHistory());
+      CHECK(historyStructureChanged());
+
+      // after undo, the history head is stale, and structural
+      // changes are relative to the model as reset
+      undo();
+      reset();
+      CHECK(!structureChanged());
+
+      // undo restores parameter values, as well as the structure
+      auto initOfA=[&]() {
+        for (auto& i: model->items)
+          if (auto v=i->variableCast())
+            if (v->type()==VariableType::parameter)
+              return string(v->init());
+        return string();
+      };
+      CHECK_EQUAL("2", initOfA());
+      undo();
+      CHECK_EQUAL("2", initOfA());
+      undo();
+      CHECK_EQUAL("1", initOfA());
+    }
+
+  TEST_FIXTURE(TestFixture,sliderParameterUpdate)
+    {
+      // dx/dt=a
+      VariablePtr a(VariableType::parameter,"a");
+      a->init("1");
+      model->addItem(a);
+      auto integ=model->addItem(OperationPtr(OperationBase::integrate));
+      model->addWire(*a,*integ,1,vector<float>());
+      IntOp* intOp=dynamic_cast<IntOp*>(integ.get());
+      CHECK(intOp);
+
+      reset();
+      runUntil(1);
+      CHECK_CLOSE(1, intOp->intVar->value(), 1e-6);
+
+      // as when dragging the slider: the value is applied at the next
+      // step, without a reset or invalidating the canvas caches
+      Canvas::Timestamp timestamp=canvas.model.timestamp;
+      a->initSliderBounds();
+      a->sliderSet(2);
+      markParameterValueSet();
+      CHECK(!reset_flag());
+      CHECK(canvas.model.timestamp==timestamp);
+      CHECK(edited());
+      CHECK_EQUAL(2, a->value());
+      nSteps=1;
+      step();
+      CHECK(t>1);
+      CHECK_CLOSE(1+2*(t-1), intOp->intVar->value(), 1e-6);
+    }
+
+  TEST_FIXTURE(TestFixture,checkpointRoundTrip)
+    {
+      // dx/dt=a
+      VariablePtr a(VariableType::parameter,"a");
+      a->init("1");
+      model->addItem(a);
+      auto integ=model->addItem(OperationPtr(OperationBase::integrate));
+      model->addWire(*a,*integ,1,vector<float>());
+      IntOp* intOp=dynamic_cast<IntOp*>(integ.get());
+      CHECK(intOp);
+
+      reset();
+      runUntil(1);
+      saveCheckpoint("checkpointRoundTrip.ckpt");
+      runUntil(2);
+      CHECK_CLOSE(2, intOp->intVar->value(), 1e-6);
+      restoreCheckpoint("checkpointRoundTrip.ckpt");
+      CHECK_CLOSE(1, t, 1e-10);
+      CHECK_CLOSE(1, intOp->intVar->value(), 1e-6);
+      runUntil(2);
+      CHECK_CLOSE(2, intOp->intVar->value(), 1e-6);
+
+      // renaming leaves the number of values unchanged, but the
+      // checkpoint no longer applies
+      a->name("b");
+      markEdited();
+      CHECK_THROW(restoreCheckpoint("checkpointRoundTrip.ckpt"), std::exception);
+    }
+
+  TEST_FIXTURE(TestFixture,outputSchedule)
+    {
+      // integrate a linear function, output at regular times
+      auto op1=model->addItem(new VarConstant);
+      auto op2=model->addItem(OperationPtr(OperationBase::integrate));
+      auto op3=model->addItem(OperationPtr(OperationBase::integrate));
+      model->addWire(*op1,*op2,1,vector<float>());
+      model->addWire(*op2,*op3,1,vector<float>());
+      double value = 10;
+      dynamic_cast<VariableBase*>(op1.get())->init(to_string(value));
+      IntOp* intOp=dynamic_cast<IntOp*>(op3.get());
+      CHECK(intOp);
+
+      stepMax=1; // solver steps may span several outputs
+      outputInterval=0.25;
+      reset();
+      for (int i=1; i<=4; ++i)
+        {
+          step();
+          CHECK_CLOSE(0.25*i, t, 1e-10);
+          CHECK_CLOSE(0.5*value*t*t, intOp->intVar->value(), 1e-5);
+        }
+
+      outputTimes={0.1, 0.5};
+      reset();
+      step();
+      CHECK_CLOSE(0.1, t, 1e-10);
+      step();
+      CHECK_CLOSE(0.5, t, 1e-10);
+      CHECK_CLOSE(0.5*value*t*t, intOp->intVar->value(), 1e-5);
+      step(); // end of schedule
+      CHECK(!running);
+      CHECK_CLOSE(0.5, t, 1e-10);
+
+      // reverse simulation ignores the schedule
+      reverse=true;
+      step();
+      CHECK(running);
+      CHECK(t<0.5);
+    }
+
   /*
     check that cyclic networks throw an exception
 
@@ -1032,4 +1605,237 @@ SUITE(Minsky)
       CHECK_EQUAL(":c",c->name());
 
    }
+
+  TEST_FIXTURE(TestFixture,binarySaveLoad)
+    {
+      auto a=model->addItem(VariablePtr(VariableType::parameter,"a"));
+      auto b=model->addItem(VariablePtr(VariableType::flow,"b"));
+      a->moveTo(10,20);
+      model->addWire(*a,*b,1);
+      integrator=rk4;
+      saveBinary("binarySaveLoad.mkb");
+      saveInBackground("binarySaveLoad.mky",false);
+      waitForBackgroundSave();
+      CHECK(!backgroundSaveRunning());
+
+      Minsky m1, m2;
+      m1.load("binarySaveLoad.mkb");
+      m2.load("binarySaveLoad.mky");
+      CHECK_EQUAL(2, m1.model->numItems());
+      CHECK_EQUAL(1, m1.model->numWires());
+      CHECK_EQUAL(m2.model->numItems(), m1.model->numItems());
+      CHECK_EQUAL(m2.model->numWires(), m1.model->numWires());
+      CHECK_EQUAL(rk4, m1.integrator);
+      CHECK_EQUAL(rk4, m2.integrator);
+    }
+
+  TEST_FIXTURE(ClipboardFixture,copyPasteDuplicate)
+    {
+      auto a=model->addItem(VariablePtr(VariableType::flow,"a"));
+      auto b=model->addItem(VariablePtr(VariableType::flow,"b"));
+      a->moveTo(100,100);
+      b->moveTo(200,100);
+      model->addWire(*a,*b,1);
+      canvas.select(50,50,250,150);
+      CHECK_EQUAL(2, canvas.selection.items.size());
+      CHECK_EQUAL(1, canvas.selection.wires.size());
+
+      copy();
+      CHECK(!clipboard.empty());
+      paste();
+      CHECK_EQUAL(1, model->groups.size());
+      checkCopy(*model->groups[0]);
+
+      // clipboard replaced by another application, so parsed as XML
+      auto text=clipboard;
+      clipboard+=" ";
+      paste();
+      CHECK_EQUAL(2, model->groups.size());
+      checkCopy(*model->groups[1]);
+      
+      duplicateSelection();
+      CHECK_EQUAL(3, model->groups.size());
+      checkCopy(*model->groups[2]);
+      // the clipboard is not touched
+      CHECK_EQUAL(text+" ", clipboard);
+      CHECK_EQUAL(2, model->items.size());
+      CHECK_EQUAL(1, model->wires.size());
+    }
+
+  TEST_FIXTURE(TestFixture,undoRedoHistory)
+    {
+      clearHistory();
+      pushHistory();
+      const unsigned numEdits=40; // spans several keyframes
+      for (unsigned i=0; i<numEdits; ++i)
+        {
+          auto v=model->addItem(VariablePtr(VariableType::flow,"v"+to_string(i)));
+          v->moveTo(10*i,20);
+          CHECK(pushHistory());
+          // nothing new to record
+          CHECK(!pushHistory());
+        }
+      CHECK_EQUAL(numEdits+1, historySize());
+      // deltas are much smaller than complete copies of each state
+      CHECK(historyBytes<5*historyHead.size());
+
+      for (unsigned i=numEdits; i>0; --i)
+        {
+          undo();
+          CHECK_EQUAL(i-1, model->items.size());
+        }
+      undo(); // no further history
+      CHECK_EQUAL(0, model->items.size());
+
+      for (unsigned i=1; i<=numEdits; ++i)
+        {
+          undo(-1);
+          CHECK_EQUAL(i, model->items.size());
+        }
+      // fully redone state is identical to the last recorded one
+      CHECK(!pushHistory());
+      undo(numEdits/2);
+      CHECK_EQUAL(numEdits/2, model->items.size());
+    }
+
+  TEST_FIXTURE(TestFixture,backgroundSaveEdited)
+    {
+      model->addItem(VariablePtr(VariableType::flow,"a"));
+      markEdited();
+      saveInBackground("backgroundSaveEdited.mkb");
+      // not saved until the write has completed
+      CHECK(edited());
+      waitForBackgroundSave();
+      CHECK(!edited());
+
+      // edits made whilst saving leave the model dirty
+      markEdited();
+      saveInBackground("backgroundSaveEdited.mkb");
+      model->addItem(VariablePtr(VariableType::flow,"b"));
+      markEdited();
+      while (!pollBackgroundSave());
+      CHECK(edited());
+
+      // a foreground save completes any background one first
+      saveInBackground("backgroundSaveEdited.mkb");
+      saveBinary("backgroundSaveEdited.mkb");
+      CHECK(!backgroundSaveRunning());
+      CHECK(!edited());
+      markEdited();
+
+      // failure is reported, and leaves the model dirty
+      saveInBackground("nonexistentDir/backgroundSaveEdited.mkb");
+      CHECK_THROW(waitForBackgroundSave(), std::exception);
+      CHECK(edited());
+      CHECK(pollBackgroundSave());
+    }
+
+  TEST_FIXTURE(TestFixture,binaryCorruptSize)
+    {
+      model->addItem(VariablePtr(VariableType::flow,"a"));
+      saveBinary("binaryCorruptSize.mkb");
+      string contents;
+      {
+        ifstream f("binaryCorruptSize.mkb", ios::binary);
+        contents.assign(istreambuf_iterator<char>(f), istreambuf_iterator<char>());
+      }
+      // overwrite the uncompressed size field in the header
+      uint64_t size=~uint64_t(0);
+      memcpy(&contents[sizeof("MinskyBin")+sizeof(uint32_t)], &size, sizeof(size));
+      {
+        ofstream f("binaryCorruptSize.mkb", ios::binary);
+        f<<contents;
+      }
+      Minsky m;
+      CHECK_THROW(m.load("binaryCorruptSize.mkb"), std::exception);
+    }
+
+  TEST_FIXTURE(TestFixture,deferredTensorInit)
+    {
+      // a is wired into the model, b is not
+      VariablePtr a(VariableType::parameter,"a"), b(VariableType::parameter,"b");
+      VariablePtr c(VariableType::flow,"c");
+      model->addItem(a);
+      model->addItem(b);
+      model->addItem(c);
+      model->addWire(*a, *c, 1, {});
+      for (auto& i: {a,b})
+        {
+          auto& v=*i->vValue();
+          v.setXVector(vector<XVector>{{"i",{"1","2","3"}}});
+          v.tensorInit.dims={3};
+          v.tensorInit.data={1,2,3};
+        }
+      save("deferredTensorInit.mky");
+
+      Minsky m;
+      m.load("deferredTensorInit.mky");
+      // loading resets the model, decoding only the data in use
+      auto& av=m.variableValues.find(a->valueId())->second;
+      CHECK(!av.deferredTensorInit);
+      CHECK_EQUAL(3, av.numElements());
+      CHECK_EQUAL(3, av.value(2));
+      auto& bv=m.variableValues.find(b->valueId())->second;
+      CHECK(bv.deferredTensorInit);
+      CHECK(bv.tensorInit.data.empty());
+
+      // accessing the initial value decodes it once
+      CHECK_EQUAL(3, bv.initValue(m.variableValues).data.size());
+      CHECK(!bv.deferredTensorInit);
+      CHECK_EQUAL(3, bv.tensorInit.data.size());
+      CHECK_EQUAL(3, bv.numElements());
+      CHECK_EQUAL(3, bv.value(2));
+    }
+
+  TEST_FIXTURE(TestFixture,logFileAfterReset)
+    {
+      VariablePtr a(VariableType::parameter,"a");
+      model->addItem(a);
+      a->init("2");
+      reset();
+      int idx=a->vValue()->idx();
+      logVarList.insert(a->valueId());
+      openLogFile("logFileAfterReset.mlog");
+      logVariables();
+
+      // A is allocated ahead of a, moving it
+      VariablePtr b(VariableType::parameter,"A");
+      model->addItem(b);
+      b->init("5");
+      reset();
+      CHECK(idx!=a->vValue()->idx());
+      logVariables();
+      closeLogFile();
+
+      vector<string> names;
+      vector<vector<double>> columns;
+      SimulationLog::readBinary("logFileAfterReset.mlog", names, columns);
+      CHECK_EQUAL(2, columns.size());
+      CHECK_EQUAL(2, columns[1].size());
+      CHECK_EQUAL(2, columns[1][0]);
+      CHECK_EQUAL(2, columns[1][1]);
+    }
+
+  TEST_FIXTURE(TestFixture,binaryLogFile)
+    {
+      VariablePtr a(VariableType::parameter,"a");
+      model->addItem(a);
+      a->init("2");
+      reset();
+      logVarList.insert(a->valueId());
+      openLogFile("binaryLogFile.mlog");
+      for (t=0; t<3; ++t)
+        logVariables();
+      closeLogFile();
+
+      vector<string> names;
+      vector<vector<double>> columns;
+      SimulationLog::readBinary("binaryLogFile.mlog", names, columns);
+      CHECK_EQUAL(2, names.size());
+      CHECK_EQUAL("a", names[1]);
+      CHECK_EQUAL(2, columns.size());
+      CHECK_EQUAL(3, columns[0].size());
+      CHECK_EQUAL(2, columns[0][2]);
+      CHECK_EQUAL(2, columns[1][1]);
+    }
 }
@@ -342,7 +342,147 @@ SUITE(Canvas)
       canvas.getWireAt(x,y);
       CHECK(canvas.wire==ab);
     }
-  
+
+  TEST_FIXTURE(TestFixture, wireHitAfterPortMove)
+    {
+      auto wireMidpoint=[&]() {
+        auto c=bc->coords();
+        canvas.getWireAt(0.5f*(c[0]+c[c.size()-2]), 0.5f*(c[1]+c.back()));
+      };
+      wireMidpoint(); // populates the wire index
+      CHECK(canvas.wire==bc);
+      // ports are repositioned when their item is drawn
+      auto& in=*c->ports[1];
+      in.moveTo(in.x()+200, in.y()+200);
+      wireMidpoint();
+      CHECK(canvas.wire==bc);
+    }
+
+  TEST_FIXTURE(TestFixture, hitTestAfterMove)
+    {
+      // populate spatial indices before moving things around
+      canvas.getItemAt(c->x(),c->y());
+      CHECK(c==canvas.item);
+      float x=c->x(), y=c->y();
+      c->moveTo(x+500,y+300);
+      canvas.getItemAt(x,y);
+      CHECK(c!=canvas.item);
+      canvas.getItemAt(c->x(),c->y());
+      CHECK(c==canvas.item);
+      CHECK(canvas.closestInPort(c->ports[1]->x()+1,c->ports[1]->y())==c->ports[1]);
+
+      // wire attached to c moves with it
+      auto from=bc->coords();
+      canvas.getWireAt(0.5f*(from[0]+from[from.size()-2]), 0.5f*(from[1]+from.back()));
+      CHECK(canvas.wire==bc);
+
+      auto d=model->addItem(new Variable<VariableType::flow>("d"));
+      d->moveTo(x,y);
+      canvas.getItemAt(x,y);
+      CHECK(d==canvas.item);
+      model->removeItem(*d);
+      canvas.getItemAt(x,y);
+      CHECK(d!=canvas.item);
+    }
+
+  TEST_FIXTURE(TestFixture, nameMarkup)
+    {
+      auto v=c->variableCast();
+      CHECK_EQUAL(latexToPango(v->name()), v->nameMarkup());
+      v->name("\\alpha_1");
+      CHECK_EQUAL(latexToPango("\\alpha_1"), v->nameMarkup());
+    }
+
+  TEST_FIXTURE(TestFixture, wireGeometry)
+    {
+      auto c0=bc->coords();
+      c->moveTo(c->x()+100, c->y()+50);
+      auto c1=bc->coords();
+      CHECK_EQUAL(c0.size(), c1.size());
+      CHECK_CLOSE(c0[c0.size()-2]+100, c1[c1.size()-2], 1e-3);
+      CHECK_CLOSE(c0.back()+50, c1.back(), 1e-3);
+      CHECK_CLOSE(c0[0], c1[0], 1e-3);
+
+      bc->coords({c1[0],c1[1],0.5f*(c1[0]+c1[2]),c1[1]+20,c1[2],c1[3]});
+      CHECK_EQUAL(6, bc->coords().size());
+      bc->straighten();
+      CHECK_EQUAL(4, bc->coords().size());
+    }
+
+  TEST_FIXTURE(TestFixture, simplifiedRendering)
+    {
+      CHECK(!canvas.simplified(*c));
+      model->setZoom(0.01);
+      CHECK(canvas.simplified(*c));
+      // ports collapse onto the item, so wires meet its outline
+      ecolab::cairo::Surface s(cairo_recording_surface_create(CAIRO_CONTENT_COLOR_ALPHA,nullptr));
+      c->drawSimplified(s.cairo());
+      for (auto& p: c->ports)
+        {
+          CHECK_CLOSE(c->x(), p->x(), 1e-4);
+          CHECK_CLOSE(c->y(), p->y(), 1e-4);
+        }
+      model->setZoom(1);
+      CHECK(!canvas.simplified(*c));
+    }
+
+  TEST_FIXTURE(TestFixture, cachedIconPorts)
+    {
+      canvas.surface.reset(new ecolab::cairo::Surface
+                           (cairo_recording_surface_create(CAIRO_CONTENT_COLOR_ALPHA,nullptr)));
+      canvas.redraw(); // caches c's icon
+      auto& in=*c->ports[1];
+      float dx=in.x()-c->x(), dy=in.y()-c->y();
+      CHECK(fabs(dx)>1);
+      // collapse c's ports onto its centre
+      canvas.minDetailSize=1e6;
+      canvas.redraw();
+      CHECK_CLOSE(c->x(), in.x(), 1e-4);
+      canvas.minDetailSize=8;
+
+      // move c, and replay its cached icon
+      c->moveTo(c->x()+100, c->y()+50);
+      canvas.redraw();
+      CHECK_CLOSE(c->x()+dx, in.x(), 1e-4);
+      CHECK_CLOSE(c->y()+dy, in.y(), 1e-4);
+      // the wire follows its ports
+      auto coords=bc->coords();
+      CHECK_CLOSE(in.x(), coords[coords.size()-2], 1e-4);
+      CHECK_CLOSE(in.y(), coords.back(), 1e-4);
+    }
+
+  TEST_FIXTURE(TestFixture, panopticonTiles)
+    {
+      canvas.surface.reset(new ecolab::cairo::Surface
+                           (cairo_recording_surface_create(CAIRO_CONTENT_COLOR_ALPHA,nullptr)));
+      panopticon.surface.reset(new ecolab::cairo::Surface
+                               (cairo_image_surface_create(CAIRO_FORMAT_ARGB32,200,200)));
+      canvas.redraw();
+      auto& in=*c->ports[1];
+      float x=in.x(), y=in.y();
+      // render the overview with items simplified, which collapses ports
+      canvas.minDetailSize=1e6;
+      panopticon.redraw(0,0,200,200);
+      CHECK_CLOSE(x, in.x(), 1e-4);
+      CHECK_CLOSE(y, in.y(), 1e-4);
+      CHECK(!panopticon.tiles.empty());
+
+      // changing c rerenders only the tiles it covers
+      auto tiles=panopticon.tiles;
+      c->selected=true;
+      canvas.model.updateTimestamp();
+      panopticon.redraw(0,0,200,200);
+      CHECK_EQUAL(tiles.size(), panopticon.tiles.size());
+      CHECK(tiles[0]==panopticon.tiles[0]);
+      bool rerendered=false;
+      for (size_t i=0; i<tiles.size(); ++i)
+        rerendered|=tiles[i]!=panopticon.tiles[i];
+      CHECK(rerendered);
+      CHECK_CLOSE(x, in.x(), 1e-4);
+      CHECK_CLOSE(y, in.y(), 1e-4);
+      canvas.minDetailSize=8;
+    }
+
   TEST_FIXTURE(Canvas,findVariableDefinition)
     {
       model=cminsky().model;
@@ -989,6 +1129,19 @@ SUITE(Minsky)
       CHECK_EQUAL(origNumItems+numItemsInGroup, model->numItems());
       CHECK_EQUAL(numItemsInGroup, group1->numItems());
     }
+
+    TEST_FIXTURE(TestFixture,hitTestAfterUndo)
+    {
+      pushHistory();
+      c->moveTo(500,500);
+      CHECK(canvas.itemAt(500,500)==c);
+      pushHistory();
+      // undo positions the recreated items directly
+      undo();
+      CHECK(!canvas.itemAt(500,500));
+      auto v=dynamic_pointer_cast<VariableBase>(canvas.itemAt(300,100));
+      CHECK(v && v->name()=="c");
+    }
 }
 
 SUITE(Integrate)
@@ -1215,6 +1368,22 @@ SUITE(GodleyTableWindow)
       for (auto& i: colWidgets) CHECK_EQUAL(-1, i.mouseOver());
     }
   
+  TEST_FIXTURE(GodleyTableWindowFixture, columnWidths)
+    {
+      godleyIcon->table.cell(1,1)="a";
+      surface.reset(new ecolab::cairo::Surface
+                    (cairo_recording_surface_create(CAIRO_CONTENT_COLOR_ALPHA,NULL)));
+      redraw(0,0,0,0);
+      double w1=colLeftMargin[2]-colLeftMargin[1];
+      godleyIcon->table.cell(1,1)="aVeryLongFlowNameThatWidensTheColumn";
+      redraw(0,0,0,0);
+      double w2=colLeftMargin[2]-colLeftMargin[1];
+      CHECK(w2>w1);
+      // cells outside the drawn region still determine column widths
+      redraw(0,0,0,1);
+      CHECK_CLOSE(w2, colLeftMargin[2]-colLeftMargin[1], 1e-6);
+    }
+  
   TEST_FIXTURE(GodleyTableWindowFixture, mouseSelect)
     {
       Tk_Init(interp()); // required for clipboard operations
@@ -0,0 +1,152 @@
+/*
+  @copyright Steve Keen 2019
+  @author Russell Standish
+  This file is part of Minsky.
+
+  Minsky is free software: you can redistribute it and/or modify it
+  under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Minsky is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Minsky.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "sparseLU.h"
+#include <UnitTest++/UnitTest++.h>
+#include <math.h>
+#include <random>
+using namespace minsky;
+using namespace std;
+
+namespace
+{
+  /// compressed column form of a dense matrix, given row by row
+  SparseMatrix sparse(const vector<vector<double>>& a)
+  {
+    SparseMatrix r;
+    r.n=a.size();
+    for (size_t j=0; j<r.n; ++j)
+      {
+        for (size_t i=0; i<r.n; ++i)
+          if (a[i][j]!=0)
+            {
+              r.rowIdx.push_back(i);
+              r.values.push_back(a[i][j]);
+            }
+        r.colStart.push_back(r.rowIdx.size());
+      }
+    return r;
+  }
+
+  double residual(const SparseMatrix& a, const vector<double>& x, const vector<double>& b)
+  {
+    auto ax=a*x;
+    double r=0;
+    for (size_t i=0; i<b.size(); ++i)
+      r=max(r, fabs(ax[i]-b[i]));
+    return r;
+  }
+}
+
+SUITE(SparseLU)
+{
+  TEST(pivoting)
+    {
+      // zero diagonal, so rows must be exchanged
+      auto a=sparse({{0,1,0},{2,0,1},{0,3,4}});
+      SparseLU lu;
+      CHECK(lu.factor(a));
+      vector<double> b{1,2,3}, x=b;
+      lu.solve(x);
+      CHECK(residual(a,x,b)<1e-12);
+
+      // small diagonal, below the pivot tolerance
+      a=sparse({{1e-6,1},{1,1}});
+      CHECK(lu.factor(a));
+      b={1,2}; x=b;
+      lu.solve(x);
+      CHECK(residual(a,x,b)<1e-12);
+      CHECK_CLOSE(1,x[0],1e-5);
+      CHECK_CLOSE(1,x[1],1e-5);
+    }
+
+  TEST(singular)
+    {
+      SparseLU lu;
+      // numerically singular
+      CHECK(!lu.factor(sparse({{1,2,0},{2,4,0},{0,0,1}})));
+      // structurally singular: empty column
+      CHECK(!lu.factor(sparse({{1,0,0},{0,0,0},{0,0,1}})));
+      // and refactor does not use a failed factorisation
+      CHECK(!lu.refactor(sparse({{1,0,0},{0,1,0},{0,0,1}})));
+    }
+
+  TEST(residual)
+    {
+      const size_t n=100;
+      mt19937 gen;
+      uniform_real_distribution<double> u(-1,1);
+      uniform_int_distribution<size_t> row(0,n-1);
+      vector<vector<double>> dense(n,vector<double>(n));
+      for (size_t i=0; i<n; ++i)
+        {
+          dense[i][i]=u(gen);
+          for (int k=0; k<3; ++k)
+            dense[row(gen)][i]=u(gen);
+        }
+      auto a=sparse(dense);
+      SparseLU lu;
+      CHECK(lu.factor(a));
+      CHECK(lu.nnz()>=a.values.size());
+      vector<double> b(n);
+      for (auto& i: b) i=u(gen);
+      auto x=b;
+      lu.solve(x);
+      CHECK(residual(a,x,b)<1e-9);
+    }
+
+  TEST(refactor)
+    {
+      auto a=sparse({{4,1,0,0},{1,4,1,0},{0,1,4,1},{0,0,1,4}});
+      SparseLU lu;
+      // nothing factored yet
+      CHECK(!lu.refactor(a));
+      CHECK(lu.factor(a));
+
+      // same pattern, different values
+      for (auto& v: a.values) v*=0.5;
+      a.values[0]=3;
+      CHECK(lu.refactor(a));
+      vector<double> b{1,2,3,4}, x=b;
+      lu.solve(x);
+      CHECK(residual(a,x,b)<1e-12);
+
+      // agrees with a fresh factorisation
+      SparseLU lu2;
+      CHECK(lu2.factor(a));
+      auto x2=b;
+      lu2.solve(x2);
+      for (size_t i=0; i<b.size(); ++i)
+        CHECK_CLOSE(x2[i],x[i],1e-12);
+
+      // the previous pivot order is no longer acceptable
+      a.values[0]=0;
+      CHECK(!lu.refactor(a));
+      CHECK(lu.factor(a));
+      x=b;
+      lu.solve(x);
+      CHECK(residual(a,x,b)<1e-12);
+
+      // a different pattern requires a full factorisation
+      auto c=sparse({{4,1,0,0},{1,4,1,0},{0,1,4,1},{1,0,1,4}});
+      CHECK(!lu.refactor(c));
+      CHECK(lu.factor(c));
+      CHECK(lu.refactor(c));
+    }
+}
@@ -43,4 +43,19 @@ SUITE(Variable)
       CHECK_THROW(valueId("foo"), ecolab::error);
 
     }
+
+  TEST_FIXTURE(VariableValue, isValueIdTest)
+    {
+      CHECK(isValueId(":foo"));
+      CHECK(isValueId("12:foo"));
+      CHECK(isValueId("constant:zero"));
+      CHECK(isValueId("constant3:one"));
+      CHECK(!isValueId("foo"));
+      CHECK(!isValueId(":"));
+      CHECK(!isValueId("1:_"));
+      CHECK(!isValueId("a1:foo"));
+      CHECK(!isValueId("1:foo:bar"));
+      CHECK(!isValueId("1:foo bar"));
+      CHECK(!isValueId("1:{foo}"));
+    }
 }